@@ -0,0 +1,110 @@
+// Write and read throughput of a float dataset with each available codec,
+// i.e. deflate, plus LZ4 and Zstandard when built in (or found as
+// plugins). Reads go through the page cache, so this measures the codec,
+// which is what matters on storage faster than the decompression
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include "uhdf5.h"
+
+const int ROWS = 4096;
+const int COLUMNS = 4096;
+const int CHUNK_ROWS = 256;
+
+double
+seconds_since(const std::chrono::steady_clock::time_point& t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+void
+run(const char *fname, const char *name, h5::DatasetCreationOptions::Compression compression,
+    int level, int threads, const std::vector<float>& values)
+{
+    const double    mb = values.size() * sizeof(float) / 1e6;
+    h5::File        file;
+    h5::Dataset     dset;
+
+    if (!file.create(fname))
+    {
+        printf("File creation failed!\n");
+        exit(-1);
+    }
+
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    h5::DatasetCreationOptions options;
+    options.chunk_dims.push_back(CHUNK_ROWS);
+    options.chunk_dims.push_back(COLUMNS);
+    options.shuffle = compression != h5::DatasetCreationOptions::COMPRESSION_NONE;
+    options.compression = compression;
+    options.compression_level = level;
+    options.compression_threads = threads;
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    bool ok = file.create_dataset<float>("/data", dims, options, dset);
+    H5Eset_auto2(H5E_DEFAULT, (H5E_auto2_t)H5Eprint2, stderr);
+
+    if (!ok)
+    {
+        printf("%-12s %5d %7d   (not available)\n", name, level, threads);
+        return;
+    }
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    dset.write<float>(const_cast<float*>(&values[0]));
+    dset.close();
+    file.close();
+    const double write_time = seconds_since(t0);
+
+    std::vector<float> read_values(values.size());
+
+    file.open(fname);
+    file.open_dataset("/data", dset);
+    const double ratio = (double)dset.get_size_in_bytes() / dset.get_size_in_file_bytes();
+
+    t0 = std::chrono::steady_clock::now();
+    dset.read<float>(&read_values[0]);
+    const double read_time = seconds_since(t0);
+
+    printf("%-12s %5d %7d %7.2f %12.0f %12.0f\n", name, level, threads, ratio,
+        mb / write_time, mb / read_time);
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: %s file.hdf5 [threads]\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    const int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    // Smooth with some noise, roughly like measurement data
+    std::vector<float> values(ROWS * COLUMNS);
+    srand(123);
+    for (int r = 0; r < ROWS; r++)
+        for (int c = 0; c < COLUMNS; c++)
+            values[r * COLUMNS + c] = 100 * std::sin(r * 0.01) * std::cos(c * 0.02) + (rand() % 100) * 0.01f;
+
+    printf("%-12s %5s %7s %7s %12s %12s\n", "codec", "level", "threads", "ratio", "write (MB/s)", "read (MB/s)");
+
+    run(argv[1], "none", h5::DatasetCreationOptions::COMPRESSION_NONE, 0, 1, values);
+    run(argv[1], "deflate", h5::DatasetCreationOptions::COMPRESSION_DEFLATE, 1, 1, values);
+    run(argv[1], "deflate", h5::DatasetCreationOptions::COMPRESSION_DEFLATE, 6, 1, values);
+    run(argv[1], "lz4", h5::DatasetCreationOptions::COMPRESSION_LZ4, 0, 1, values);
+    run(argv[1], "lz4", h5::DatasetCreationOptions::COMPRESSION_LZ4, 0, threads, values);
+    run(argv[1], "lz4hc", h5::DatasetCreationOptions::COMPRESSION_LZ4, 9, threads, values);
+    run(argv[1], "zstd", h5::DatasetCreationOptions::COMPRESSION_ZSTD, 1, 1, values);
+    run(argv[1], "zstd", h5::DatasetCreationOptions::COMPRESSION_ZSTD, 3, threads, values);
+    run(argv[1], "zstd", h5::DatasetCreationOptions::COMPRESSION_ZSTD, -3, 1, values);
+
+    return 0;
+}
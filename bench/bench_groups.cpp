@@ -0,0 +1,115 @@
+// Time creating and looking up members of one large flat group: a default
+// group (a symbol table), one created with GroupCreationOptions (dense link
+// storage, allowed to raise the file to the 1.8 format) and the same in a
+// file using the latest format
+#include <cstdlib>
+#include <chrono>
+#include "uhdf5.h"
+
+const int LOOKUPS = 10000;
+
+double
+seconds_since(const std::chrono::steady_clock::time_point& t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+enum Variant
+{
+    DEFAULT,
+    OPTIONS,
+    LATEST_FORMAT
+};
+
+const char *variant_names[] = { "default", "options", "latest" };
+
+void
+run(const char *fname, int members, Variant variant)
+{
+    h5::File        file;
+    h5::FileOptions file_options;
+    h5::Group       group;
+    h5::Dataset     dset;
+
+    file_options.latest_format = variant == LATEST_FORMAT;
+    if (!file.create(fname, true, file_options))
+    {
+        printf("File creation failed!\n");
+        exit(-1);
+    }
+
+    bool ok;
+    if (variant != DEFAULT)
+    {
+        h5::GroupCreationOptions options;
+        options.upgrade_file_format = true;
+        ok = file.create_group("/members", options, group);
+    }
+    else
+        ok = file.create_group("/members", group);
+
+    if (!ok)
+    {
+        printf("Group creation failed!\n");
+        exit(-1);
+    }
+
+    h5::dimensions  dims;
+    char            name[32];
+
+    dims.push_back(1);
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < members; i++)
+    {
+        sprintf(name, "item%08d", i);
+        group.create_dataset<float>(name, dims, h5::DatasetCreationOptions(), dset);
+    }
+
+    const double create_time = seconds_since(t0);
+
+    srand(123);
+    t0 = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        sprintf(name, "item%08d", rand() % members);
+        if (!group.open_dataset(name, dset))
+        {
+            printf("Lookup failed!\n");
+            exit(-1);
+        }
+    }
+
+    const double lookup_time = seconds_since(t0);
+
+    printf("%-8s %9d %14.2f %14.2f\n", variant_names[variant], members,
+        1e6 * create_time / members, 1e6 * lookup_time / LOOKUPS);
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: %s file.hdf5 [max-members]\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    const int max_members = argc > 2 ? atoi(argv[2]) : 100000;
+
+    printf("%-8s %9s %14s %14s\n", "group", "members", "create (us)", "lookup (us)");
+
+    for (int members = 1000; members <= max_members; members *= 10)
+    {
+        run(argv[1], members, DEFAULT);
+        run(argv[1], members, OPTIONS);
+        run(argv[1], members, LATEST_FORMAT);
+    }
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef UHDF5_TESTS_CHECK_H
+#define UHDF5_TESTS_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+
+// Ends the test if a check fails
+static inline void
+check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("%s failed!\n", what);
+        exit(-1);
+    }
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include <cstdlib>
+#include "uhdf5.h"
+#include "check.h"
+
+// Write rows [0, N) in blocks of varying (small) sizes
+void
+write_rows(h5::BufferedWriter& writer, int N, int M)
+{
+    float   row[7*M];
+    int     i = 0, n = 1;
+
+    while (i < N)
+    {
+        n = std::min(n % 7 + 1, N - i);
+        for (int r = 0; r < n; r++)
+            for (int j = 0; j < M; j++)
+                row[r*M+j] = (i+r)*M + j;
+        check(writer.write<float>(row, n), "Buffered write");
+        i += n;
+    }
+}
+
+void
+write_file(const char *fname, int N, int M)
+{
+    h5::File        file;
+    h5::Dataset     *dset;
+
+    file.create(fname);
+
+    h5::dimensions dims, chunk_dims;
+    dims.push_back(N);
+    dims.push_back(M);
+    chunk_dims.push_back(5);
+    chunk_dims.push_back(M);
+
+    // Fixed size
+
+    dset = file.create_dataset<float>("/fixed", dims, false, &chunk_dims, true);
+    {
+        h5::BufferedWriter writer(dset);
+        write_rows(writer, N, M);
+    }
+    delete dset;
+
+    // Appendable, starting empty
+
+    dims[0] = 0;
+    dset = file.create_appendable_dataset<float>("/appendable", dims, chunk_dims, false, true);
+    {
+        h5::BufferedWriter writer(dset);
+        write_rows(writer, N, M);
+        check(writer.close(), "Close");
+        check(writer.close(), "Second close");
+    }
+    delete dset;
+
+    // Rows that can't be written on close
+
+    dims[0] = N;
+    dset = file.create_dataset<float>("/closed", dims, false, &chunk_dims, true);
+    {
+        h5::BufferedWriter writer(dset);
+        float values[M];
+        for (int i = 0; i < M; i++)
+            values[i] = i;
+
+        check(writer.write<float>(values, 1), "Buffered write");
+        dset->close();
+        H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+        check(!writer.close(), "Close after dataset closed");
+    }
+    delete dset;
+}
+
+void
+read_file(const char *fname, int N, int M)
+{
+    h5::File        file;
+    h5::Dataset     *dset;
+
+    file.open(fname);
+
+    const char *names[2] = { "/fixed", "/appendable" };
+    for (int d = 0; d < 2; d++)
+    {
+        dset = file.open_dataset(names[d]);
+
+        h5::dimensions dims, maxdims;
+        dset->get_dimensions(dims);
+        dset->get_max_dimensions(maxdims);
+        printf("%s: %d x %d, max %d x %d\n", names[d], dims[0], dims[1], maxdims[0], maxdims[1]);
+        check(dims[0] == N && dims[1] == M, "Dimensions");
+
+        float *values = new float[N*M];
+        check(dset->read<float>(values), "Read");
+        for (int i = 0; i < N*M; i++)
+            check(values[i] == i, "Value");
+        delete [] values;
+
+        delete dset;
+    }
+
+    printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1], 53, 3);
+    read_file(argv[1], 53, 3);
+}
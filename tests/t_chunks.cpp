@@ -0,0 +1,113 @@
+#include <cstdlib>
+#include "uhdf5.h"
+
+void
+write_file(const char *fname, int N, int M)
+{
+    h5::File        file;
+    h5::Dataset     *dset;
+
+    file.create(fname);
+
+    int32_t *values = new int32_t[N*M];
+    for (int i = 0; i < N*M; i++)
+        values[i] = i;
+
+    h5::dimensions dims, chunk_dims;
+
+    dims.push_back(N);
+    dims.push_back(M);
+
+    chunk_dims.push_back(4);
+    chunk_dims.push_back(5);
+
+    dset = file.create_dataset<int32_t>("/values", dims, true, &chunk_dims, true);
+    dset->write<int32_t>(values);
+    delete [] values;
+
+    delete dset;
+}
+
+void
+read_file(const char *fname, int N, int M)
+{
+    h5::File        file;
+    h5::Dataset     *dset;
+
+    file.open(fname);
+
+    dset = file.open_dataset("/values");
+
+    std::vector<h5::ChunkInfo> chunks;
+    if (!dset->get_chunks(chunks))
+    {
+        printf("Could not get chunks!\n");
+        exit(-1);
+    }
+
+    printf("%zu chunks\n", chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        const h5::ChunkInfo& c = chunks[i];
+        printf("[%d, %d] address %llu, %llu bytes filtered, %llu bytes unfiltered\n",
+            c.offset[0], c.offset[1], (unsigned long long)c.address,
+            (unsigned long long)c.filtered_size, (unsigned long long)c.unfiltered_size);
+
+        if (i > 0 && c.address <= chunks[i-1].address)
+        {
+            printf("Chunks not sorted by address!\n");
+            exit(-1);
+        }
+    }
+
+    if (chunks.size() != (size_t)((N+3)/4) * ((M+4)/5))
+    {
+        printf("Unexpected number of chunks!\n");
+        exit(-1);
+    }
+
+    // Every element must be visited exactly once
+    int64_t sum = 0, count = 0;
+
+    dset->for_each_chunk<int32_t>([&](const h5::ChunkInfo& chunk, const h5::dimensions& cnt, const int32_t *values)
+    {
+        for (int i = 0; i < cnt[0]; i++)
+            for (int j = 0; j < cnt[1]; j++)
+            {
+                int32_t expected = (chunk.offset[0]+i)*M + chunk.offset[1]+j;
+                if (values[i*cnt[1]+j] != expected)
+                {
+                    printf("Chunk value mismatch at [%d, %d]!\n", chunk.offset[0]+i, chunk.offset[1]+j);
+                    exit(-1);
+                }
+                sum += values[i*cnt[1]+j];
+                count++;
+            }
+    });
+
+    printf("%lld elements, sum %lld\n", (long long)count, (long long)sum);
+
+    if (count != N*M || sum != (int64_t)N*M*(N*M-1)/2)
+    {
+        printf("Chunk scan didn't cover the dataset!\n");
+        exit(-1);
+    }
+
+    delete dset;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1], 13, 17);
+    read_file(argv[1], 13, 17);
+}
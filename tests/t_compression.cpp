@@ -0,0 +1,192 @@
+#include <cstdlib>
+#include <cmath>
+#include "uhdf5.h"
+#include "check.h"
+
+const int ROWS = 1000;
+const int COLUMNS = 1000;
+const int CHUNK_ROWS = 250;
+
+struct Codec
+{
+    const char                                  *path;
+    h5::DatasetCreationOptions::Compression     compression;
+    int                                         level;
+    int                                         threads;
+};
+
+// Only those built in (or available as plugins) get tested
+const Codec codecs[] =
+{
+    { "/deflate",       h5::DatasetCreationOptions::COMPRESSION_DEFLATE, 4, 1 },
+#ifdef UHDF5_WITH_LZ4
+    { "/lz4",           h5::DatasetCreationOptions::COMPRESSION_LZ4, 0, 1 },
+    { "/lz4_threads",   h5::DatasetCreationOptions::COMPRESSION_LZ4, 0, 4 },
+    { "/lz4hc",         h5::DatasetCreationOptions::COMPRESSION_LZ4, 9, 2 },
+#endif
+#ifdef UHDF5_WITH_ZSTD
+    { "/zstd",          h5::DatasetCreationOptions::COMPRESSION_ZSTD, 3, 1 },
+    { "/zstd_threads",  h5::DatasetCreationOptions::COMPRESSION_ZSTD, 9, 4 },
+    { "/zstd_fast",     h5::DatasetCreationOptions::COMPRESSION_ZSTD, -5, 1 },
+#endif
+};
+
+const int NUM_CODECS = sizeof(codecs) / sizeof(codecs[0]);
+
+float
+value(int row, int col)
+{
+    return std::floor(100 * std::sin(row * 0.01) * std::cos(col * 0.02));
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.create(fname), "File creation");
+
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    std::vector<float> values(ROWS * COLUMNS);
+    for (int r = 0; r < ROWS; r++)
+        for (int c = 0; c < COLUMNS; c++)
+            values[r * COLUMNS + c] = value(r, c);
+
+    for (int i = 0; i < NUM_CODECS; i++)
+    {
+        h5::DatasetCreationOptions options;
+        options.chunk_dims.push_back(CHUNK_ROWS);
+        options.chunk_dims.push_back(COLUMNS);
+        options.shuffle = true;
+        options.compression = codecs[i].compression;
+        options.compression_level = codecs[i].level;
+        options.compression_threads = codecs[i].threads;
+
+        check(file.create_dataset<float>(codecs[i].path, dims, options, dset), codecs[i].path);
+        check(dset.write<float>(&values[0]), "Dataset write");
+    }
+
+#ifdef UHDF5_WITH_LZ4
+    // Without a level LZ4 stays plain LZ4, not LZ4HC
+    {
+        h5::DatasetCreationOptions options;
+        options.chunk_dims.push_back(CHUNK_ROWS);
+        options.chunk_dims.push_back(COLUMNS);
+        options.compression = h5::DatasetCreationOptions::COMPRESSION_LZ4;
+
+        check(file.create_dataset<float>("/lz4_default", dims, options, dset), "LZ4 default level");
+
+        hid_t       plist_id = H5Dget_create_plist(dset.get_id());
+        unsigned    flags;
+        size_t      cd_nelmts = 3;
+        unsigned    cd_values[3] = { 0, 0, 0 };
+
+        check(H5Pget_filter_by_id2(plist_id, 32004, &flags, &cd_nelmts, cd_values, 0, NULL, NULL) >= 0, "LZ4 filter");
+        check(cd_nelmts == 3 && cd_values[1] == 0, "LZ4 default level is plain LZ4");
+        H5Pclose(plist_id);
+    }
+#endif
+
+#ifndef UHDF5_WITH_LZ4
+    // Neither built in nor a plugin
+    if (H5Zfilter_avail(32004) <= 0)
+    {
+        h5::DatasetCreationOptions options;
+        options.compression = h5::DatasetCreationOptions::COMPRESSION_LZ4;
+        check(!file.create_dataset<float>("/lz4", dims, options, dset), "LZ4 without a filter");
+    }
+#endif
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.open(fname), "File open");
+
+    std::vector<float> values(ROWS * COLUMNS);
+
+    for (int i = 0; i < NUM_CODECS; i++)
+    {
+        check(file.open_dataset(codecs[i].path, dset), "Dataset open");
+        check(dset.is_compressed(), "Compressed");
+        check(dset.get_size_in_file_bytes() < values.size() * sizeof(float) / 4, "Compression ratio");
+
+        check(dset.read<float>(&values[0]), "Dataset read");
+        for (int r = 0; r < ROWS; r++)
+            for (int c = 0; c < COLUMNS; c++)
+                check(values[r * COLUMNS + c] == value(r, c), "Dataset values");
+
+        printf("%-14s %8.1f KiB\n", codecs[i].path, dset.get_size_in_file_bytes() / 1024.0);
+    }
+
+#ifdef UHDF5_WITH_LZ4
+    // The LZ4 plugin stream format: original size and block size, big-endian
+    check(file.open_dataset("/lz4_threads", dset), "Dataset open");
+
+    hsize_t     offset[2] = { 0, 0 };
+    hsize_t     chunk_bytes;
+    uint32_t    filter_mask = 0;
+
+    check(H5Dget_chunk_storage_size(dset.get_id(), offset, &chunk_bytes) >= 0, "Chunk size");
+
+    std::vector<unsigned char> chunk(chunk_bytes);
+    check(H5Dread_chunk(dset.get_id(), H5P_DEFAULT, offset, &filter_mask, &chunk[0]) >= 0, "Raw chunk read");
+
+    uint64_t size = 0;
+    for (int i = 0; i < 8; i++)
+        size = (size << 8) | chunk[i];
+    uint32_t block_size = (chunk[8] << 24) | (chunk[9] << 16) | (chunk[10] << 8) | chunk[11];
+
+    check(size == CHUNK_ROWS * COLUMNS * sizeof(float), "LZ4 header size");
+    check(block_size == size / 4, "LZ4 header block size");
+
+    // A block size of 0 would leave the output undecoded
+    dset.close();
+    file.close();
+    check(file.open(fname, false), "File open for writing");
+    check(file.open_dataset("/lz4_threads", dset), "Dataset open");
+
+    chunk[8] = chunk[9] = chunk[10] = chunk[11] = 0;
+    check(H5Dwrite_chunk(dset.get_id(), H5P_DEFAULT, 0, offset, 12, &chunk[0]) >= 0, "Raw chunk write");
+
+    hsize_t count[2] = { CHUNK_ROWS, COLUMNS };
+    hid_t   space_id = H5Dget_space(dset.get_id());
+    hid_t   mem_space_id = H5Screate_simple(2, count, NULL);
+    H5Sselect_hyperslab(space_id, H5S_SELECT_SET, offset, NULL, count, NULL);
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    check(H5Dread(dset.get_id(), H5T_NATIVE_FLOAT, mem_space_id, space_id, H5P_DEFAULT, &values[0]) < 0,
+        "Zero LZ4 block size rejected");
+    H5Eset_auto2(H5E_DEFAULT, (H5E_auto2_t)H5Eprint2, stderr);
+
+    H5Sclose(mem_space_id);
+    H5Sclose(space_id);
+#endif
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <cstdlib>
+#include <string>
+#include "uhdf5.h"
+#include "check.h"
+
+const int N = 100000;
+
+void
+write_source(const char *fname, int part)
+{
+    h5::File    file;
+    h5::Dataset dset;
+    h5::Attribute attr;
+
+    check(file.create(fname), "Source file creation");
+
+    h5::dimensions dims;
+    dims.push_back(N);
+
+    h5::DatasetCreationOptions options;
+    options.layout = h5::DatasetCreationOptions::LAYOUT_CHUNKED;
+    options.shuffle = true;
+    options.compression = h5::DatasetCreationOptions::COMPRESSION_DEFLATE;
+
+    std::vector<int32_t> values(N);
+    for (int i = 0; i < N; i++)
+        values[i] = part * N + i / 10;
+
+    h5::Group   group;
+    check(file.create_group("/results", group), "Group creation");
+
+    std::string path = "part" + std::to_string(part);
+    check(group.create_dataset<int32_t>(path.c_str(), dims, options, dset), "Dataset creation");
+    check(dset.write<int32_t>(&values[0]), "Dataset write");
+
+    h5::dimensions adims;
+    adims.push_back(1);
+    float scale = 0.5f * part;
+    check(dset.create_attribute<float>("scale", adims, attr), "Attribute creation");
+    check(attr.write<float>(&scale), "Attribute write");
+}
+
+size_t
+stored_size(h5::File& file, const char *path)
+{
+    h5::Dataset dset;
+
+    check(file.open_dataset(path, dset), "Source dataset open");
+
+    return dset.get_size_in_file_bytes();
+}
+
+void
+check_copy(h5::FileAndGroupParent& parent, const char *path, int part, size_t stored_size)
+{
+    h5::Dataset     dset;
+    h5::Attribute   attr;
+
+    check(parent.open_dataset(path, dset), "Copied dataset open");
+    check(dset.is_compressed(), "Copy is compressed");
+    check(dset.get_size_in_file_bytes() == stored_size, "Copy has same stored size");
+
+    std::vector<int32_t> values(N);
+    check(dset.read<int32_t>(&values[0]), "Copied dataset read");
+    for (int i = 0; i < N; i++)
+        check(values[i] == part * N + i / 10, "Copied value");
+
+    float scale;
+    check(dset.get_attribute("scale", attr), "Copied attribute");
+    check(attr.read<float>(&scale) && scale == 0.5f * part, "Copied attribute value");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 (and file.hdf5.src0/1) will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    std::string src0 = std::string(argv[1]) + ".src0";
+    std::string src1 = std::string(argv[1]) + ".src1";
+
+    write_source(src0.c_str(), 0);
+    write_source(src1.c_str(), 1);
+
+    h5::File    dst, s0, s1;
+
+    check(dst.create(argv[1]), "Destination creation");
+    check(s0.open(src0.c_str(), true) && s1.open(src1.c_str(), true), "Source open");
+
+    const size_t size0 = stored_size(s0, "/results/part0");
+    const size_t size1 = stored_size(s1, "/results/part1");
+
+    // Single object, into a group that doesn't exist yet
+    check(h5::File::copy_object(s0, "/results/part0", dst, "/single/a/part0"), "Object copy");
+    check_copy(dst, "/single/a/part0", 0, size0);
+
+    // Merge both groups into one
+    check(h5::File::copy_group_members(s0, "/results", dst, "/merged"), "Group copy 0");
+    check(h5::File::copy_group_members(s1, "/results", dst, "/merged"), "Group copy 1");
+    check_copy(dst, "/merged/part0", 0, size0);
+    check_copy(dst, "/merged/part1", 1, size1);
+
+    // Existing members aren't overwritten
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    check(!h5::File::copy_group_members(s1, "/results", dst, "/merged"), "Group copy conflict");
+
+    printf("All tests passed\n");
+
+    return 0;
+}
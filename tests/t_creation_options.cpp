@@ -0,0 +1,122 @@
+#include <cstdlib>
+#include <cstdint>
+#include "uhdf5.h"
+#include "check.h"
+
+typedef h5::DatasetCreationOptions Options;
+
+// Layout, chunk dimensions and allocation/fill times of a created dataset
+struct Created
+{
+    H5D_layout_t        layout;
+    h5::dimensions      chunk_dims;
+    H5D_alloc_time_t    alloc_time;
+    H5D_fill_time_t     fill_time;
+};
+
+bool
+create(h5::File& file, const char *path, int rows, int columns, const Options& options, Created& created)
+{
+    h5::Dataset     dset;
+    h5::dimensions  dims;
+
+    dims.push_back(rows);
+    dims.push_back(columns);
+
+    if (!file.create_dataset<float>(path, dims, options, dset))
+        return false;
+
+    hid_t   plist_id = H5Dget_create_plist(dset.get_id());
+    hsize_t c[2];
+
+    created.layout = H5Pget_layout(plist_id);
+    created.chunk_dims.clear();
+    if (created.layout == H5D_CHUNKED)
+    {
+        H5Pget_chunk(plist_id, 2, c);
+        created.chunk_dims.push_back(c[0]);
+        created.chunk_dims.push_back(c[1]);
+    }
+    H5Pget_alloc_time(plist_id, &created.alloc_time);
+    H5Pget_fill_time(plist_id, &created.fill_time);
+    H5Pclose(plist_id);
+
+    return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    h5::File    file;
+    Options     options;
+    Created     created;
+
+    check(file.create(argv[1]), "File creation");
+
+    // Up to 16 KiB: compact, allocated early, never filled
+    check(create(file, "/compact", 64, 64, options, created), "Dataset creation");
+    check(created.layout == H5D_COMPACT && created.alloc_time == H5D_ALLOC_TIME_EARLY, "Compact layout");
+    check(created.fill_time == H5D_FILL_TIME_NEVER, "Fill time");
+
+    // Above that, unfiltered: contiguous, allocated late
+    check(create(file, "/contiguous", 64, 65, options, created), "Dataset creation");
+    check(created.layout == H5D_CONTIGUOUS && created.alloc_time == H5D_ALLOC_TIME_LATE, "Contiguous layout");
+
+    options.compact_size_limit = 64 * 65 * sizeof(float);
+    check(create(file, "/compact_limit", 64, 65, options, created), "Dataset creation");
+    check(created.layout == H5D_COMPACT, "Compact size limit");
+    options = Options();
+
+    // Filtered: chunked, allocated incrementally, 4 MB halved to 1 MiB chunks
+    options.compression = Options::COMPRESSION_DEFLATE;
+    check(create(file, "/filtered", 1000, 1000, options, created), "Dataset creation");
+    check(created.layout == H5D_CHUNKED && created.alloc_time == H5D_ALLOC_TIME_INCR, "Chunked layout");
+    check(created.chunk_dims[0] == 500 && created.chunk_dims[1] == 500, "Automatic chunk dimensions");
+
+    // Even small filtered datasets
+    check(create(file, "/small_filtered", 4, 4, options, created), "Dataset creation");
+    check(created.layout == H5D_CHUNKED && created.chunk_dims[0] == 4 && created.chunk_dims[1] == 4,
+        "Small chunked layout");
+    options = Options();
+
+    // Extendable: chunks of whole rows, 1 MiB worth of them
+    options.max_dims.push_back(h5::UNLIMITED);
+    options.max_dims.push_back(256);
+    check(create(file, "/extendable", 0, 256, options, created), "Dataset creation");
+    check(created.layout == H5D_CHUNKED && created.chunk_dims[0] == 1024 && created.chunk_dims[1] == 256,
+        "Extendable layout");
+    options = Options();
+
+    // Given chunk dimensions
+    options.chunk_dims.push_back(10);
+    options.chunk_dims.push_back(20);
+    check(create(file, "/given_chunks", 100, 100, options, created), "Dataset creation");
+    check(created.layout == H5D_CHUNKED && created.chunk_dims == options.chunk_dims, "Given chunk dimensions");
+    options = Options();
+
+    // Explicit layout and times
+    options.layout = Options::LAYOUT_CONTIGUOUS;
+    options.alloc_time = Options::ALLOC_TIME_EARLY;
+    options.fill_time = Options::FILL_TIME_ALLOC;
+    check(create(file, "/explicit", 4, 4, options, created), "Dataset creation");
+    check(created.layout == H5D_CONTIGUOUS && created.alloc_time == H5D_ALLOC_TIME_EARLY &&
+        created.fill_time == H5D_FILL_TIME_ALLOC, "Explicit layout");
+
+    // Filters need chunks
+    options.compression = Options::COMPRESSION_DEFLATE;
+    printf("Expect an error below\n");
+    check(!create(file, "/invalid", 4, 4, options, created), "Filters without chunks");
+
+    printf("All tests passed\n");
+
+    return 0;
+}
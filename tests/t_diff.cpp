@@ -0,0 +1,172 @@
+#include <cstdlib>
+#include <cstdint>
+#include "uhdf5.h"
+#include "check.h"
+
+const int ROWS = 256;
+const int COLUMNS = 192;
+const int CHUNK = 64;
+
+void
+create(h5::File& file, const char *path, std::vector<float>& values, const h5::DatasetCreationOptions& options)
+{
+    h5::Dataset dset;
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    check(file.create_dataset<float>(path, dims, options, dset), "Dataset creation");
+    check(dset.write<float>(&values[0]), "Dataset write");
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+
+    check(file.create(fname), "File creation");
+
+    std::vector<float> values(ROWS * COLUMNS);
+    for (int i = 0; i < ROWS * COLUMNS; i++)
+        values[i] = (i % COLUMNS) * 0.5f + (i / COLUMNS);
+
+    h5::DatasetCreationOptions options;
+    options.layout = h5::DatasetCreationOptions::LAYOUT_CHUNKED;
+    options.chunk_dims.push_back(CHUNK);
+    options.chunk_dims.push_back(CHUNK);
+    options.compression = h5::DatasetCreationOptions::COMPRESSION_DEFLATE;
+    options.compression_level = 6;
+
+    create(file, "/a", values, options);
+
+    // Same pipeline, 4 elements changed in 3 chunks
+    std::vector<float> modified(values);
+    modified[0] = -1;
+    modified[1] = -1;
+    modified[70 * COLUMNS + 130] = -1;
+    modified[(ROWS - 1) * COLUMNS + COLUMNS - 1] = -1;
+    create(file, "/b", modified, options);
+
+    // Other compression level, same values
+    options.compression_level = 1;
+    create(file, "/c", values, options);
+
+    // Contiguous
+    create(file, "/d", modified, h5::DatasetCreationOptions());
+
+    // Deduplicated: two copies of the same data, and a constant one
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    h5::DedupWriter<float>  writer;
+    h5::Dataset             dset;
+
+    options.compression_level = 6;
+    check(writer.create(file, "/pool", options.chunk_dims, options), "Dedup writer creation");
+    check(writer.write("/dedup_a", &values[0], dims, dset), "Dedup write");
+    check(writer.write("/dedup_b", &modified[0], dims, dset), "Dedup write");
+
+    std::vector<float> constant(128 * 100, 5.0f);
+    h5::dimensions small;
+    small.push_back(128);
+    small.push_back(100);
+    check(writer.write("/dedup_constant", &constant[0], small, dset), "Dedup write");
+
+    // Chunk (r, c) holds the values of chunk (0, 0) plus r*64 + c*32, so a
+    // has 9 unique chunks of 12, and b adds its 3 changed ones. The
+    // constant dataset has 2 full and 2 partial (zero-padded) chunks
+    check(writer.get_num_chunks() == 12 + 12 + 4, "Number of chunks");
+    check(writer.get_num_unique_chunks() == 9 + 3 + 2, "Number of unique chunks");
+    writer.close();
+
+    // Pool and datasets in a group
+    h5::Group group;
+    check(file.create_group("/group", group), "Group creation");
+    check(writer.create(group, "group_pool", options.chunk_dims, options), "Dedup writer creation");
+    check(writer.write("data", &values[0], dims, dset), "Dedup write");
+    check(writer.get_num_unique_chunks() == 9, "Number of unique chunks");
+    writer.close();
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset a, b, c, d, dedup;
+
+    check(file.open(fname), "File open");
+    check(file.open_dataset("/a", a), "Dataset open");
+    check(file.open_dataset("/b", b), "Dataset open");
+    check(file.open_dataset("/c", c), "Dataset open");
+    check(file.open_dataset("/d", d), "Dataset open");
+
+    std::vector<h5::DatasetDifference>  differences;
+    h5::DiffStatistics                  stats;
+
+    // Equal to itself without decoding
+    check(a.diff(a, differences, &stats), "Diff");
+    check(differences.empty() && stats.blocks == 12 && stats.raw_equal == 12 && stats.decoded == 0, "Self diff");
+
+    // Only the changed chunks are decoded
+    check(a.diff(b, differences, &stats), "Diff");
+    check(stats.raw_equal == 9 && stats.decoded == 3, "Raw comparison");
+    check(differences.size() == 3, "Number of differences");
+    check(differences[0].offset[0] == 0 && differences[0].offset[1] == 0 && differences[0].num_elements == 2,
+        "First difference");
+    check(differences[1].offset[0] == 64 && differences[1].offset[1] == 128 && differences[1].num_elements == 1,
+        "Second difference");
+    check(differences[2].offset[0] == 192 && differences[2].offset[1] == 128 &&
+        differences[2].count[0] == 64 && differences[2].count[1] == 64, "Last difference");
+
+    // Different stored bytes, same values
+    check(a.diff(c, differences, &stats), "Diff");
+    check(differences.empty() && stats.decoded == 12, "Diff across pipelines");
+
+    // Contiguous against chunked, by chunk
+    check(d.diff(a, differences, &stats), "Diff");
+    check(differences.size() == 3 && stats.blocks == 12 && stats.raw_equal == 0, "Diff with contiguous");
+
+    // Deduplicated datasets read back as written
+    check(file.open_dataset("/dedup_a", dedup), "Dataset open");
+    check(dedup.diff(a, differences) && differences.empty(), "Dedup read");
+    check(file.open_dataset("/dedup_b", dedup), "Dataset open");
+    check(dedup.diff(b, differences) && differences.empty(), "Dedup read");
+
+    check(file.open_dataset("/group/data", dedup), "Dataset open");
+    check(dedup.diff(a, differences) && differences.empty(), "Dedup read from a group");
+
+    // Not the fill value (0)
+    std::vector<float> constant(128 * 100);
+    h5::dimensions dims;
+    check(file.open_dataset("/dedup_constant", dedup), "Dataset open");
+    dedup.get_dimensions(dims);
+    check(dims[0] == 128 && dims[1] == 100, "Dedup dimensions");
+    check(dedup.read<float>(&constant[0]), "Dedup read");
+    for (size_t i = 0; i < constant.size(); i++)
+        check(constant[i] == 5.0f, "Dedup values");
+
+    // Mismatches are rejected
+    printf("Expect errors below\n");
+    check(!dedup.diff(a, differences), "Diff with other dimensions");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
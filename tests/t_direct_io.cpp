@@ -0,0 +1,110 @@
+#include <cstdlib>
+#include "uhdf5.h"
+#include "check.h"
+
+const int ROWS = 1000;
+const int COLUMNS = 1001;       // Rows not block-aligned
+
+float
+value(int i)
+{
+    return i * 0.25f;
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File        file;
+    h5::FileOptions options;
+    h5::Dataset     dset;
+
+    options.direct_io = true;
+    check(file.create(fname, true, options), "Direct I/O file creation");
+
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    // Written from a deliberately unaligned buffer
+    std::vector<float> storage(ROWS * COLUMNS + 1);
+    float *values = &storage[1];
+    for (int i = 0; i < ROWS * COLUMNS; i++)
+        values[i] = value(i);
+
+    h5::DatasetCreationOptions contiguous;
+    contiguous.layout = h5::DatasetCreationOptions::LAYOUT_CONTIGUOUS;
+    check(file.create_dataset<float>("/contiguous", dims, contiguous, dset), "Contiguous dataset creation");
+    check(dset.write<float>(values), "Contiguous dataset write");
+
+    h5::DatasetCreationOptions chunked;
+    chunked.layout = h5::DatasetCreationOptions::LAYOUT_CHUNKED;
+    chunked.compression = h5::DatasetCreationOptions::COMPRESSION_DEFLATE;
+    check(file.create_dataset<float>("/chunked", dims, chunked, dset), "Chunked dataset creation");
+    check(dset.write<float>(values), "Chunked dataset write");
+
+    // Small and unaligned
+    dims.clear();
+    dims.push_back(3);
+    check(file.create_dataset<float>("/small", dims, h5::DatasetCreationOptions(), dset), "Small dataset creation");
+    check(dset.write<float>(values), "Small dataset write");
+}
+
+void
+check_file(const char *fname, bool direct_io)
+{
+    h5::File        file;
+    h5::FileOptions options;
+    h5::Dataset     dset;
+
+    options.direct_io = direct_io;
+    check(file.open(fname, true, options), "File open");
+
+    std::vector<float> values(ROWS * COLUMNS);
+
+    const char *paths[] = { "/contiguous", "/chunked" };
+    for (int p = 0; p < 2; p++)
+    {
+        check(file.open_dataset(paths[p], dset), "Dataset open");
+        check(dset.read<float>(&values[0]), "Dataset read");
+        for (int i = 0; i < ROWS * COLUMNS; i++)
+            check(values[i] == value(i), "Dataset value");
+    }
+
+    // Unaligned hyperslab
+    h5::dimensions offset, count;
+    offset.push_back(17);
+    offset.push_back(3);
+    count.push_back(5);
+    count.push_back(7);
+    check(file.open_dataset("/contiguous", dset), "Dataset open");
+    check(dset.read_hyperslab<float>(&values[1], offset, count), "Hyperslab read");
+    for (int r = 0; r < 5; r++)
+        for (int c = 0; c < 7; c++)
+            check(values[1 + r * 7 + c] == value((17 + r) * COLUMNS + 3 + c), "Hyperslab value");
+
+    check(file.open_dataset("/small", dset), "Small dataset open");
+    check(dset.read<float>(&values[0]) && values[2] == value(2), "Small dataset read");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+
+    // Readable with and without direct I/O
+    check_file(argv[1], true);
+    check_file(argv[1], false);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <cstdlib>
+#include <thread>
+#include "uhdf5.h"
+#include "check.h"
+
+const int ROWS = 500;
+const int COLUMNS = 300;
+const int THREADS = 8;
+const int READS = 2000;
+
+int32_t
+value(int row, int col)
+{
+    return row * 1000 + col;
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.create(fname), "File creation");
+
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    std::vector<int32_t> values(ROWS * COLUMNS);
+    for (int r = 0; r < ROWS; r++)
+        for (int c = 0; c < COLUMNS; c++)
+            values[r * COLUMNS + c] = value(r, c);
+
+    h5::DatasetCreationOptions contiguous;
+    contiguous.layout = h5::DatasetCreationOptions::LAYOUT_CONTIGUOUS;
+    check(file.create_dataset<int32_t>("/contiguous", dims, contiguous, dset), "Contiguous dataset creation");
+    check(dset.write<int32_t>(&values[0]), "Contiguous dataset write");
+
+    // Edge chunks, and the last row of chunks not written
+    h5::DatasetCreationOptions chunked;
+    chunked.chunk_dims.push_back(64);
+    chunked.chunk_dims.push_back(48);
+    check(file.create_dataset<int32_t>("/chunked", dims, chunked, dset), "Chunked dataset creation");
+
+    h5::dimensions offset, count;
+    offset.push_back(0);
+    offset.push_back(0);
+    count.push_back(448);
+    count.push_back(COLUMNS);
+    check(dset.write_hyperslab<int32_t>(&values[0], offset, count), "Chunked dataset write");
+
+    h5::DatasetCreationOptions compressed;
+    compressed.compression = h5::DatasetCreationOptions::COMPRESSION_DEFLATE;
+    check(file.create_dataset<int32_t>("/compressed", dims, compressed, dset), "Compressed dataset creation");
+}
+
+int32_t
+expected(bool chunked, int row, int col)
+{
+    return chunked && row >= 448 ? 0 : value(row, col);
+}
+
+void
+reader(h5::DirectReader *reader, bool chunked, int seed, bool *ok)
+{
+    std::vector<int32_t> values(ROWS * COLUMNS);
+    h5::dimensions offset(2), count(2);
+
+    *ok = true;
+    srand(seed);
+
+    for (int i = 0; i < READS; i++)
+    {
+        offset[0] = rand() % ROWS;
+        offset[1] = rand() % COLUMNS;
+        count[0] = 1 + rand() % (ROWS - offset[0]);
+        count[1] = 1 + rand() % (COLUMNS - offset[1]);
+        if (i % 4 == 0)
+        {
+            // Whole rows
+            offset[1] = 0;
+            count[1] = COLUMNS;
+        }
+
+        if (!reader->read_hyperslab<int32_t>(&values[0], offset, count))
+        {
+            *ok = false;
+            return;
+        }
+
+        for (int r = 0; r < count[0]; r++)
+            for (int c = 0; c < count[1]; c++)
+                if (values[r * count[1] + c] != expected(chunked, offset[0] + r, offset[1] + c))
+                {
+                    *ok = false;
+                    return;
+                }
+    }
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File            file;
+    h5::Dataset         dset;
+    h5::DirectReader    direct;
+
+    check(file.open(fname, true), "File open");
+
+    const char *paths[] = { "/contiguous", "/chunked" };
+    for (int p = 0; p < 2; p++)
+    {
+        check(file.open_dataset(paths[p], dset), "Dataset open");
+        check(direct.open(dset), "Direct reader open");
+
+        std::thread threads[THREADS];
+        bool        ok[THREADS];
+
+        for (int t = 0; t < THREADS; t++)
+            threads[t] = std::thread(reader, &direct, p == 1, t, &ok[t]);
+        for (int t = 0; t < THREADS; t++)
+        {
+            threads[t].join();
+            check(ok[t], "Threaded direct reads");
+        }
+    }
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+
+    float f;
+    h5::dimensions offset(2, 0), count(2, 1);
+    check(!direct.read_hyperslab<float>(&f, offset, count), "Read with wrong type");
+    offset[0] = ROWS;
+    check(!direct.read_hyperslab<int32_t>((int32_t*)&f, offset, count), "Read out of range");
+
+    check(file.open_dataset("/compressed", dset), "Dataset open");
+    check(!direct.open(dset), "Direct reader of compressed dataset");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "uhdf5.h"
+#include "check.h"
+
+const int ROWS = 1000;
+const int COLUMNS = 50;
+const int HEADER = 100;             // Bytes before the data in the first raw file
+const int SPLIT_ROWS = 300;         // Rows in the first raw file
+
+// Raw files next to the HDF5 file
+std::string
+raw_name(const char *fname, int part, bool relative)
+{
+    std::string name(fname);
+    if (relative && name.rfind('/') != std::string::npos)
+        name = name.substr(name.rfind('/') + 1);
+
+    return name + (part == 0 ? ".raw0" : ".raw1");
+}
+
+void
+write_raw_files(const char *fname)
+{
+    std::vector<int32_t> values(ROWS * COLUMNS);
+    for (int i = 0; i < ROWS * COLUMNS; i++)
+        values[i] = i;
+
+    FILE *f = fopen(raw_name(fname, 0, false).c_str(), "wb");
+    check(f != NULL, "Raw file creation");
+
+    char header[HEADER];
+    memset(header, 'x', HEADER);
+    fwrite(header, 1, HEADER, f);
+    fwrite(&values[0], sizeof(int32_t), SPLIT_ROWS * COLUMNS, f);
+    fclose(f);
+
+    f = fopen(raw_name(fname, 1, false).c_str(), "wb");
+    check(f != NULL, "Raw file creation");
+    fwrite(&values[SPLIT_ROWS * COLUMNS], sizeof(int32_t), (ROWS - SPLIT_ROWS) * COLUMNS, f);
+    fclose(f);
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.create(fname), "File creation");
+
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    std::vector<h5::ExternalFile> files(2);
+    files[0].filename = raw_name(fname, 0, true);
+    files[0].offset = HEADER;
+    files[0].size = SPLIT_ROWS * COLUMNS * sizeof(int32_t);
+    files[1].filename = raw_name(fname, 1, true);
+    files[1].offset = 0;
+    files[1].size = 0;
+
+    check(file.create_external_dataset<int32_t>("/external", dims, files, dset), "External dataset creation");
+    check(dset.get_metadata().external, "External metadata");
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+
+    // Too small, and an open size not at the end
+    files[1].size = 1000;
+    check(!file.create_external_dataset<int32_t>("/small", dims, files, dset), "Too small external files");
+    files[0].size = 0;
+    check(!file.create_external_dataset<int32_t>("/open", dims, files, dset), "Open size in the middle");
+
+    // Missing, or shorter than the part of the data it should hold
+    files[0].size = SPLIT_ROWS * COLUMNS * sizeof(int32_t);
+    files[1].size = 0;
+    files[1].filename = raw_name(fname, 1, true) + ".missing";
+    check(!file.create_external_dataset<int32_t>("/missing", dims, files, dset), "Missing external file");
+    files[1].filename = raw_name(fname, 1, true);
+    files[1].offset = 4;
+    check(!file.create_external_dataset<int32_t>("/short", dims, files, dset), "Short external file");
+    check(!file.exists("/missing") && !file.exists("/short"), "No datasets for bad external files");
+
+    H5Eset_auto2(H5E_DEFAULT, (H5E_auto2_t)H5Eprint2, stderr);
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    // External files are found relative to the HDF5 file, not here
+    char cwd[4096];
+    check(getcwd(cwd, sizeof(cwd)) != NULL, "Getting the current directory");
+    std::string path = fname[0] == '/' ? std::string(fname) : std::string(cwd) + "/" + fname;
+    check(chdir("/") == 0, "Changing directory");
+
+    check(file.open(path.c_str(), false), "File open");
+    check(file.open_dataset("/external", dset), "External dataset open");
+
+    std::vector<int32_t> values(ROWS * COLUMNS);
+    check(dset.read<int32_t>(&values[0]), "Full read");
+    for (int i = 0; i < ROWS * COLUMNS; i++)
+        check(values[i] == i, "Full read values");
+
+    // Across the two raw files
+    h5::dimensions offset, count;
+    offset.push_back(SPLIT_ROWS - 5);
+    offset.push_back(10);
+    count.push_back(10);
+    count.push_back(20);
+    check(dset.read_hyperslab<int32_t>(&values[0], offset, count), "Hyperslab read");
+    for (int r = 0; r < 10; r++)
+        for (int c = 0; c < 20; c++)
+            check(values[r * 20 + c] == (SPLIT_ROWS - 5 + r) * COLUMNS + 10 + c, "Hyperslab values");
+
+    // Writes go to the raw files
+    for (int i = 0; i < 200; i++)
+        values[i] = -i;
+    check(dset.write_hyperslab<int32_t>(&values[0], offset, count), "Hyperslab write");
+
+    dset.close();
+    file.close();
+
+    FILE *f = fopen(raw_name(path.c_str(), 1, false).c_str(), "rb");
+    check(f != NULL, "Raw file open");
+    // Row SPLIT_ROWS, i.e. hyperslab row 5, starts the second raw file
+    int32_t value;
+    fseek(f, 10 * sizeof(int32_t), SEEK_SET);
+    check(fread(&value, sizeof(value), 1, f) == 1 && value == -100, "Raw file contents");
+    fclose(f);
+
+    // No copy of the data in the HDF5 file
+    struct stat st;
+    check(stat(path.c_str(), &st) == 0 && st.st_size < ROWS * COLUMNS * (off_t)sizeof(int32_t) / 10, "HDF5 file size");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_raw_files(argv[1]);
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <cstdlib>
+#include <string>
+#include "uhdf5.h"
+#include "check.h"
+
+const int NUM_FILES = 10;
+const int MAX_OPEN = 4;
+
+ssize_t
+open_files()
+{
+    return H5Fget_obj_count(H5F_OBJ_ALL, H5F_OBJ_FILE);
+}
+
+std::string
+file_name(const char *prefix, int i)
+{
+    return std::string(prefix) + "." + std::to_string(i);
+}
+
+void
+write_files(const char *prefix)
+{
+    for (int i = 0; i < NUM_FILES; i++)
+    {
+        h5::File    file;
+        h5::Dataset dset;
+
+        check(file.create(file_name(prefix, i).c_str()), "File creation");
+
+        h5::dimensions dims;
+        dims.push_back(1);
+
+        int32_t value = i;
+        check(file.create_dataset<int32_t>("/value", dims, h5::DatasetCreationOptions(), dset), "Dataset creation");
+        check(dset.write<int32_t>(&value), "Dataset write");
+    }
+}
+
+void
+read_files(const char *prefix)
+{
+    h5::FilePool    pool(MAX_OPEN);
+
+    // Held, so never evicted
+    std::shared_ptr<h5::File> first = pool.open(file_name(prefix, 0).c_str());
+    check(first != NULL, "Pool open");
+
+    for (int pass = 0; pass < 3; pass++)
+        for (int i = 0; i < NUM_FILES; i++)
+        {
+            std::shared_ptr<h5::Dataset> dset = pool.open_dataset(file_name(prefix, i).c_str(), "/value");
+            check(dset != NULL, "Pool dataset open");
+
+            int32_t value;
+            check(dset->read<int32_t>(&value) && value == i, "Dataset read");
+
+            check(pool.open_dataset(file_name(prefix, i).c_str(), "/value") == dset, "Cached dataset");
+            check(pool.get_num_open() <= MAX_OPEN && open_files() <= MAX_OPEN, "Open file limit");
+        }
+
+    check(pool.open(file_name(prefix, 0).c_str()) == first, "Reused file");
+
+    // All in use, so beyond the limit
+    std::vector<std::shared_ptr<h5::File> > files;
+    for (int i = 0; i < NUM_FILES; i++)
+        files.push_back(pool.open(file_name(prefix, i).c_str()));
+    check(pool.get_num_open() == NUM_FILES, "Files in use kept open");
+
+    files.clear();
+    first.reset();
+    pool.clear();
+    check(pool.get_num_open() == 0 && open_files() == 0, "Clear");
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    check(pool.open(file_name(prefix, NUM_FILES).c_str()) == NULL, "Missing file");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5.0 to file.hdf5.%d will be overwritten if they exist!\n", NUM_FILES - 1);
+        printf("\n");
+        exit(-1);
+    }
+
+    write_files(argv[1]);
+    read_files(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <cstdlib>
+#include "uhdf5.h"
+#include "check.h"
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    h5::File                    file;
+    h5::FileOptions             file_options;
+    h5::Group                   group;
+    h5::GroupCreationOptions    options;
+
+    file_options.latest_format = true;
+    check(file.create(argv[1], true, file_options), "File creation");
+
+    // Intermediate groups get created
+    options.track_creation_order = true;
+    check(file.create_group("/a/b/members", options, group), "Group creation");
+
+    hid_t       gcpl_id = H5Gget_create_plist(group.get_id());
+    unsigned    flags, max_compact, min_dense;
+
+    H5Pget_link_creation_order(gcpl_id, &flags);
+    check(flags == (H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED), "Creation order");
+    H5Pget_link_phase_change(gcpl_id, &max_compact, &min_dense);
+    check(max_compact == options.max_compact && min_dense == options.min_dense, "Phase change");
+    H5Pclose(gcpl_id);
+
+    h5::dimensions  dims;
+    h5::Dataset     dset;
+    char            name[32];
+
+    dims.push_back(1);
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(name, "item%04d", i);
+        check(group.create_dataset<int32_t>(name, dims, h5::DatasetCreationOptions(), dset), "Member creation");
+    }
+
+    H5G_info_t  info;
+    H5Gget_info(group.get_id(), &info);
+    check(info.nlinks == 1000 && info.storage_type == H5G_STORAGE_TYPE_DENSE, "Dense storage");
+
+    check(file.open_dataset("/a/b/members/item0999", dset), "Member lookup");
+
+    // Without intermediate groups
+    options.create_intermediate = false;
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    check(!file.create_group("/c/d", options, group), "Group creation without intermediate");
+
+    // Default options in a file in the default format: only if allowed
+    // to switch the file to the 1.8 format, then dense too, while plain
+    // groups created before that are symbol tables
+    h5::Group   plain;
+
+    group.close();
+    dset.close();
+    file.close();
+    check(file.create(argv[1]), "File creation");
+    check(file.create_group("/plain", plain), "Group creation");
+    check(!file.create_group("/large", h5::GroupCreationOptions(), group), "No silent format switch");
+
+    hid_t           fapl_id = H5Fget_access_plist(file.get_id());
+    H5F_libver_t    low, high;
+
+    H5Pget_libver_bounds(fapl_id, &low, &high);
+    H5Pclose(fapl_id);
+    check(low == H5F_LIBVER_EARLIEST, "Format kept");
+
+    options = h5::GroupCreationOptions();
+    options.upgrade_file_format = true;
+    check(file.create_group("/large", options, group), "Group creation");
+
+    for (int i = 0; i < 10; i++)
+    {
+        sprintf(name, "item%04d", i);
+        check(group.create_dataset<int32_t>(name, dims, h5::DatasetCreationOptions(), dset), "Member creation");
+        check(plain.create_dataset<int32_t>(name, dims, h5::DatasetCreationOptions(), dset), "Member creation");
+    }
+
+    H5Gget_info(group.get_id(), &info);
+    check(info.nlinks == 10 && info.storage_type == H5G_STORAGE_TYPE_DENSE, "Dense storage by default");
+    H5Gget_info(plain.get_id(), &info);
+    check(info.nlinks == 10 && info.storage_type == H5G_STORAGE_TYPE_SYMBOL_TABLE, "Symbol table");
+
+    fapl_id = H5Fget_access_plist(file.get_id());
+    H5Pget_libver_bounds(fapl_id, &low, &high);
+    H5Pclose(fapl_id);
+    check(low == H5F_LIBVER_V18, "Format switch");
+
+    // HDF5 defaults keep a symbol table
+    options = h5::GroupCreationOptions();
+    options.max_compact = 8;
+    options.min_dense = 6;
+    group.close();
+    plain.close();
+    dset.close();
+    file.close();
+    check(file.create(argv[1]), "File creation");
+    check(file.create_group("/small", options, group), "Group creation");
+    H5Gget_info(group.get_id(), &info);
+    check(info.storage_type == H5G_STORAGE_TYPE_SYMBOL_TABLE, "Symbol table with HDF5 defaults");
+
+    printf("All tests passed\n");
+
+    return 0;
+}
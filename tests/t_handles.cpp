@@ -0,0 +1,74 @@
+#include <cstdlib>
+#include "uhdf5.h"
+#include "check.h"
+
+ssize_t
+count_open(h5::File& file, unsigned types)
+{
+    return H5Fget_obj_count(file.get_id(), types);
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    h5::File        file;
+    h5::Dataset     dset;
+    h5::Attribute   attr;
+    h5::Group       group;
+    h5::Type        type;
+
+    file.create(argv[1]);
+
+    h5::dimensions dims;
+    dims.push_back(10);
+
+    h5::DatasetCreationOptions options;
+    check(file.create_group("/group", group), "Group creation");
+    check(group.create_dataset<uint16_t>("values", dims, options, dset), "Dataset creation");
+    check(dset.create_attribute<float>("scale", dims, attr), "Attribute creation");
+    attr.close();
+    dset.close();
+    group.close();
+
+    const ssize_t datasets = count_open(file, H5F_OBJ_DATASET);
+    const ssize_t attributes = count_open(file, H5F_OBJ_ATTR);
+
+    // Open (and implicitly close) many times, all on the stack
+
+    for (int i = 0; i < 10000; i++)
+    {
+        check(file.open_dataset("/group/values", dset), "Dataset open");
+        check(dset.get_size_in_bytes() == 20, "Dataset size");
+        check(dset.get_type(type) && type.matches<uint16_t>(), "Dataset type");
+        check(dset.get_attribute("scale", attr), "Attribute open");
+        check(attr.get_type(type) && type.matches<float>(), "Attribute type");
+    }
+
+    // Moving transfers ownership
+
+    h5::Dataset other(std::move(dset));
+    check(!dset.is_valid() && other.is_valid(), "Dataset move");
+    other.close();
+
+    // Attributes outlive the dataset they came from
+    float scales[10] = { 0 };
+    check(attr.read<float>(scales), "Attribute read after the dataset closed");
+    attr.close();
+    type.close();
+
+    printf("%zd datasets, %zd attributes open\n", count_open(file, H5F_OBJ_DATASET), count_open(file, H5F_OBJ_ATTR));
+
+    check(count_open(file, H5F_OBJ_DATASET) == datasets, "Dataset leak check");
+    check(count_open(file, H5F_OBJ_ATTR) == attributes, "Attribute leak check");
+
+    printf("OK\n");
+}
@@ -0,0 +1,121 @@
+#include <cstdlib>
+#include <cmath>
+#include "uhdf5.h"
+#include "check.h"
+
+const int ROWS = 1000;
+const int COLUMNS = 1000;
+
+void
+write_file(const char *fname)
+{
+    h5::File        file;
+    h5::FileOptions options;
+    h5::IOMonitor   monitor;
+    h5::Dataset     dset;
+
+    options.io_monitor = &monitor;
+    check(file.create(fname, true, options), "File creation");
+
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    std::vector<float> values(ROWS * COLUMNS);
+    for (int i = 0; i < ROWS * COLUMNS; i++)
+        values[i] = i;
+
+    h5::DatasetCreationOptions contiguous;
+    contiguous.layout = h5::DatasetCreationOptions::LAYOUT_CONTIGUOUS;
+    check(file.create_dataset<float>("/contiguous", dims, contiguous, dset), "Contiguous dataset creation");
+    check(dset.write<float>(&values[0]), "Contiguous dataset write");
+
+    h5::DatasetCreationOptions chunked;
+    chunked.chunk_dims.push_back(100);
+    chunked.chunk_dims.push_back(100);
+    check(file.create_dataset<float>("/chunked", dims, chunked, dset), "Chunked dataset creation");
+    check(dset.write<float>(&values[0]), "Chunked dataset write");
+
+    dset.close();
+    file.close();
+
+    check(monitor.writes > 0 && monitor.bytes_written >= 2 * values.size() * sizeof(float), "Write counters");
+    check(monitor.reads == 0 && monitor.operations.empty(), "No reads or log");
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File        file;
+    h5::FileOptions options;
+    h5::IOMonitor   monitor;
+    h5::Dataset     dset;
+
+    monitor.log = true;
+    options.io_monitor = &monitor;
+    check(file.open(fname, true, options), "File open");
+
+    std::vector<float> values(ROWS * COLUMNS);
+    h5::dimensions offset, count;
+    offset.push_back(10);
+    offset.push_back(0);
+    count.push_back(10);
+    count.push_back(COLUMNS);
+
+    // Consecutive rows of a contiguous dataset take a single read
+    check(file.open_dataset("/contiguous", dset), "Contiguous dataset open");
+    monitor.reset();
+    check(dset.read_hyperslab<float>(&values[0], offset, count), "Contiguous hyperslab read");
+    check(monitor.reads == 1, "Single read for contiguous rows");
+    // Possibly more, as small reads fill HDF5's sieve buffer
+    check(monitor.bytes_read >= 10 * COLUMNS * sizeof(float), "Bytes read");
+    check(monitor.operations.size() == 1 && !monitor.operations[0].write, "Logged operation");
+    check(values[0] == 10 * COLUMNS, "Contiguous value");
+
+    // One read per chunk, once the chunk index is cached
+    check(file.open_dataset("/chunked", dset), "Chunked dataset open");
+    check(dset.read_hyperslab<float>(&values[0], offset, count), "Chunked hyperslab read");
+    monitor.reset();
+    offset[0] = 200;
+    count[1] = 250;
+    check(dset.read_hyperslab<float>(&values[0], offset, count), "Chunked hyperslab read");
+    check(monitor.reads <= 3, "At most one read per chunk");
+    check(values[0] == 200 * COLUMNS, "Chunked value");
+
+    // Simulated latency
+    monitor.reset();
+    monitor.latency = 0.01;
+    monitor.bandwidth = 100e6;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    check(file.open_dataset("/contiguous", dset), "Contiguous dataset open");
+    check(dset.read<float>(&values[0]), "Contiguous dataset read");
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+
+    const double expected = monitor.reads * 0.01 + monitor.bytes_read / 100e6;
+    check(monitor.delay > 0.0 && fabs(monitor.delay - expected) < 1e-6, "Simulated delay");
+    check(elapsed.count() >= monitor.delay, "Elapsed time");
+
+    printf("Read %lu bytes in %lu operations, %.3f s (%.3f s simulated)\n", (unsigned long)monitor.bytes_read,
+        (unsigned long)monitor.reads, elapsed.count(), monitor.delay);
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "uhdf5.h"
+#include "check.h"
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Group   group;
+    h5::Dataset dset;
+    h5::Attribute attr;
+
+    check(file.create(fname), "File creation");
+    check(file.create_group("/a", group), "Group creation");
+    check(group.create_group("b", group), "Group creation");
+
+    h5::dimensions dims;
+    dims.push_back(10);
+
+    std::vector<float> values(10, 1.0f);
+    check(group.create_dataset<float>("data", dims, h5::DatasetCreationOptions(), dset), "Dataset creation");
+    check(dset.write<float>(&values[0]), "Dataset write");
+    check(dset.create_attribute<float>("scale", dims, attr), "Attribute creation");
+    check(attr.write<float>(&values[0]), "Attribute write");
+
+    check(H5Lcreate_soft("/nowhere", file.get_id(), "/dangling", H5P_DEFAULT, H5P_DEFAULT) >= 0, "Soft link");
+}
+
+void
+probe(const char *fname)
+{
+    h5::File    file;
+    h5::Group   group;
+    h5::Dataset dset;
+
+    check(file.open(fname), "File open");
+
+    check(file.exists("/"), "Root");
+    check(file.exists("/a") && file.exists("a") && file.exists("/a/b/") && file.exists("//a//b"), "Groups");
+    check(file.exists("/a/b/data"), "Dataset");
+    check(!file.exists(""), "Empty path");
+    check(!file.exists("/x"), "Missing object");
+    check(!file.exists("/x/y/z") && !file.exists("/a/x/data"), "Missing groups");
+    check(!file.exists("/a/b/data/x"), "Dataset as a group");
+    check(!file.exists("/dangling"), "Dangling link");
+
+    // Relative to a group, sharing the file's lookups
+    check(file.open_group("/a", group), "Group open");
+    check(group.exists("b/data") && group.exists("/a/b"), "Relative paths");
+    check(!group.exists("data") && !group.exists("x/y"), "Relative missing paths");
+
+    h5::dimensions dims;
+    check(file.try_open_dataset("/a/b/data", dset), "Optional dataset");
+    dset.get_dimensions(dims);
+    check(dims.size() == 1 && dims[0] == 10, "Optional dataset dimensions");
+    check(!file.try_open_dataset("/a/b/missing", dset), "Missing optional dataset");
+    check(!file.try_open_dataset("/a/b", dset), "Group as a dataset");
+    check(!file.try_open_dataset("/missing/data", dset), "Missing group");
+
+    check(file.try_open_dataset("/a/b/data", dset), "Optional dataset");
+    check(dset.has_attribute("scale") && !dset.has_attribute("offset"), "Attributes");
+
+    // Creating invalidates the missing paths, including through groups
+    check(!file.exists("/a/c/data"), "Missing path");
+    check(group.create_group("c", group), "Group creation");
+    check(file.exists("/a/c") && !file.exists("/a/c/data"), "Created group");
+
+    check(group.create_dataset<float>("data", dims, h5::DatasetCreationOptions(), dset),
+        "Dataset creation");
+    check(file.exists("/a/c/data") && group.exists("data"), "Created dataset");
+
+    // Objects created through another File object are seen after clearing
+    h5::File    other;
+    h5::Group   other_group;
+
+    check(!file.exists("/late"), "Missing group");
+    check(other.open(fname), "File open");
+    check(other.create_group("/late", other_group), "Group creation");
+    check(!file.exists("/late"), "Remembered missing path");
+    file.clear_lookup_cache();
+    check(file.exists("/late"), "Cleared missing path");
+
+    // Groups without a name don't add to the missing paths
+    check(file.open_group("/a/c", group), "Group open");
+    check(H5Ldelete(file.get_id(), "/a/c", H5P_DEFAULT) >= 0, "Group unlink");
+    check(!group.exists("late") && file.exists("/late"), "Unlinked group");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+
+    // Nothing printed while probing
+    char    errors[] = "/tmp/t_lookups_XXXXXX";
+    int     fd = mkstemp(errors);
+    int     saved = dup(2);
+    struct stat st;
+
+    check(fd >= 0, "Temporary file");
+    fflush(stderr);
+    dup2(fd, 2);
+
+    probe(argv[1]);
+
+    fflush(stderr);
+    dup2(saved, 2);
+    check(fstat(fd, &st) == 0 && st.st_size == 0, "Silent probing");
+    close(fd);
+    unlink(errors);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <cstdlib>
+#include "uhdf5.h"
+#include "check.h"
+
+void
+write_file(const char *fname, int N, int M)
+{
+    h5::File        file;
+    h5::Dataset     *dset;
+
+    file.create(fname);
+
+    h5::dimensions dims;
+    dims.push_back(N);
+    dims.push_back(M);
+
+    // Write x, y and z from a single array of structs
+
+    double *xyz = new double[N*M*3];
+    for (int i = 0; i < N*M; i++)
+    {
+        xyz[3*i+0] = i;
+        xyz[3*i+1] = -i;
+        xyz[3*i+2] = 0.5*i;
+    }
+
+    const char *names[3] = { "/x", "/y", "/z" };
+    for (int f = 0; f < 3; f++)
+    {
+        dset = file.create_dataset<double>(names[f], dims);
+        dset->write<double>(xyz, h5::MemoryLayout::interleaved(dims, f, 3));
+        delete dset;
+    }
+
+    delete [] xyz;
+}
+
+void
+read_file(const char *fname, int N, int M)
+{
+    h5::File        file;
+    h5::Dataset     *dset;
+
+    file.open(fname);
+
+    dset = file.open_dataset("/x");
+
+    h5::dimensions dims;
+    dset->get_dimensions(dims);
+
+    // Column-major
+
+    double *values = new double[N*M];
+    check(dset->read<double>(values, h5::MemoryLayout::column_major(dims)), "Column-major read");
+
+    for (int i = 0; i < N; i++)
+        for (int j = 0; j < M; j++)
+            check(values[j*N+i] == i*M+j, "Column-major value");
+
+    delete [] values;
+
+    // Hyperslab into column-major
+
+    h5::dimensions offset, count;
+    offset.push_back(2);
+    offset.push_back(1);
+    count.push_back(3);
+    count.push_back(4);
+
+    values = new double[3*4];
+    h5::MemoryLayout layout = h5::MemoryLayout::column_major(count);
+    check(dset->read_hyperslab<double>(values, offset, count, &layout), "Hyperslab read");
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 4; j++)
+            check(values[j*3+i] == (2+i)*M+1+j, "Hyperslab value");
+
+    delete [] values;
+    delete dset;
+
+    // Interleave all three back into an array of structs
+
+    const char *names[3] = { "/x", "/y", "/z" };
+    float *xyz = new float[N*M*3];
+    for (int f = 0; f < 3; f++)
+    {
+        dset = file.open_dataset(names[f]);
+        check(dset->read<float>(xyz, h5::MemoryLayout::interleaved(dims, f, 3)), "Interleaved read");
+        delete dset;
+    }
+
+    for (int i = 0; i < N*M; i++)
+        check(xyz[3*i] == i && xyz[3*i+1] == -i && xyz[3*i+2] == 0.5f*i, "Interleaved value");
+
+    delete [] xyz;
+
+    printf("OK\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1], 7, 5);
+    read_file(argv[1], 7, 5);
+}
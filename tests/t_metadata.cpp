@@ -0,0 +1,119 @@
+#include <cstdlib>
+#include <cstdint>
+#include "uhdf5.h"
+#include "check.h"
+
+void
+write_file(const char *fname)
+{
+    h5::File                    file;
+    h5::Dataset                 dset;
+    h5::DatasetCreationOptions  options;
+    h5::dimensions              dims;
+
+    check(file.create(fname), "File creation");
+
+    // 400 bytes, below the compact size limit
+    dims.push_back(100);
+    std::vector<int32_t> values(1000 * 100, 7);
+    check(file.create_dataset<int32_t>("/compact", dims, options, dset), "Dataset creation");
+    check(dset.write<int32_t>(&values[0]), "Dataset write");
+
+    dims[0] = 1000 * 100;
+    check(file.create_dataset<int32_t>("/contiguous", dims, options, dset), "Dataset creation");
+    check(dset.write<int32_t>(&values[0]), "Dataset write");
+
+    // Shuffling alone doesn't compress
+    options.shuffle = true;
+    options.chunk_dims.push_back(1000);
+    check(file.create_dataset<int32_t>("/chunked", dims, options, dset), "Dataset creation");
+    check(dset.write<int32_t>(&values[0]), "Dataset write");
+
+    options.compression = h5::DatasetCreationOptions::COMPRESSION_DEFLATE;
+    options.max_dims.push_back(h5::UNLIMITED);
+    check(file.create_dataset<uint16_t>("/deflated", dims, options, dset), "Dataset creation");
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.open(fname), "File open");
+
+    // Nothing opened
+    check(!dset.is_chunked() && !dset.is_compressed(), "Default layout");
+    check(dset.get_metadata().type_class == h5::Type::NONE && dset.get_metadata().element_size == 0 &&
+        dset.get_metadata().chunk_dims.empty() && dset.get_metadata().filters.empty(), "Default metadata");
+
+    check(file.open_dataset("/compact", dset), "Dataset open");
+    const h5::DatasetMetadata& metadata = dset.get_metadata();
+    check(metadata.layout == h5::DatasetMetadata::LAYOUT_COMPACT && !dset.is_chunked() && !dset.is_compressed(),
+        "Compact layout");
+    check(metadata.type_class == h5::Type::INTEGER && metadata.is_signed &&
+        metadata.element_size == 4 && metadata.native_element_size == 4, "Type");
+    check(metadata.max_dims.size() == 1 && metadata.max_dims[0] == 100, "Maximum dimensions");
+
+    check(file.open_dataset("/contiguous", dset), "Dataset open");
+    check(metadata.layout == h5::DatasetMetadata::LAYOUT_CONTIGUOUS && !dset.is_chunked() && !dset.is_compressed(),
+        "Contiguous layout");
+    check(metadata.storage_size == 1000 * 100 * 4, "Storage size");
+
+    check(file.open_dataset("/chunked", dset), "Dataset open");
+    check(metadata.layout == h5::DatasetMetadata::LAYOUT_CHUNKED && dset.is_chunked() && !dset.is_compressed(),
+        "Chunked layout");
+    check(metadata.chunk_dims.size() == 1 && metadata.chunk_dims[0] == 1000, "Chunk dimensions");
+    check(metadata.filters.size() == 1 && metadata.filters[0] == H5Z_FILTER_SHUFFLE, "Filters");
+
+    check(file.open_dataset("/deflated", dset), "Dataset open");
+    check(dset.is_chunked() && dset.is_compressed(), "Compressed layout");
+    check(metadata.filters.size() == 2 && metadata.filters[0] == H5Z_FILTER_SHUFFLE &&
+        metadata.filters[1] == H5Z_FILTER_DEFLATE, "Filter pipeline");
+    check(metadata.type_class == h5::Type::INTEGER && !metadata.is_signed && metadata.element_size == 2, "Type");
+    check(metadata.max_dims[0] == h5::UNLIMITED, "Unlimited dimension");
+
+    // Values must match the type, apart from floating-point precision
+    std::vector<uint16_t>   u16(1000 * 100);
+    std::vector<int16_t>    i16(1000 * 100);
+    std::vector<uint32_t>   u32(1000 * 100);
+    std::vector<float>      f(1000 * 100);
+    std::vector<double>     d(1000 * 100);
+
+    check(dset.read<uint16_t>(&u16[0]), "Matching read");
+    printf("Expect errors below\n");
+    check(!dset.read<int16_t>(&i16[0]) && !dset.read<uint32_t>(&u32[0]) && !dset.read<float>(&f[0]),
+        "Mismatching reads");
+
+    check(file.open_dataset("/compact", dset), "Dataset open");
+    check(!dset.write<uint32_t>(&u32[0]), "Mismatching write");
+
+    h5::dimensions  dims(1, 100);
+    check(file.create_dataset<float>("/floats", dims, h5::DatasetCreationOptions(), dset), "Dataset creation");
+    check(dset.write<double>(&d[0]) && dset.read<float>(&f[0]), "Floating-point conversion");
+
+    // Closing forgets the metadata
+    dset.close();
+    check(!dset.is_chunked() && dset.get_metadata().type_class == h5::Type::NONE, "Closed metadata");
+    check(!dset.read<float>(&f[0]), "Read after closing");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
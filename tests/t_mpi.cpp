@@ -0,0 +1,143 @@
+// Run with e.g. mpirun -np 4 t_mpi file.hdf5
+#include <cstdlib>
+#include "uhdf5.h"
+
+const int ROWS_PER_RANK = 1000;
+const int COLUMNS = 16;
+
+int rank, size;
+
+void
+check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("[%d] %s failed!\n", rank, what);
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+}
+
+float
+value(int row, int col)
+{
+    return row * COLUMNS + col;
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.create(fname, MPI_COMM_WORLD), "Parallel file creation");
+
+    h5::dimensions dims;
+    dims.push_back(ROWS_PER_RANK * size);
+    dims.push_back(COLUMNS);
+
+    h5::DatasetCreationOptions options;
+    options.layout = h5::DatasetCreationOptions::LAYOUT_CONTIGUOUS;
+    check(file.create_dataset<float>("/values", dims, options, dset), "Dataset creation");
+    check(dset.is_collective(), "Collective by default");
+
+    std::vector<float> rows(ROWS_PER_RANK * COLUMNS);
+    for (int r = 0; r < ROWS_PER_RANK; r++)
+        for (int c = 0; c < COLUMNS; c++)
+            rows[r * COLUMNS + c] = value(rank * ROWS_PER_RANK + r, c);
+
+    h5::dimensions offset, count;
+    offset.push_back(rank * ROWS_PER_RANK);
+    offset.push_back(0);
+    count.push_back(ROWS_PER_RANK);
+    count.push_back(COLUMNS);
+
+    check(dset.write_hyperslab<float>(&rows[0], offset, count), "Collective write");
+
+    // Every rank takes part, including those without data
+    count[0] = rank == 0 ? 1 : 0;
+    offset[0] = 0;
+    check(dset.write_hyperslab<float>(&rows[0], offset, count), "Collective write of only rank 0");
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.open(fname, MPI_COMM_WORLD, true), "Parallel file open");
+    check(file.open_dataset("/values", dset), "Dataset open");
+
+    // Each rank reads back the rows of the next one
+    const int other = (rank + 1) % size;
+
+    std::vector<float> rows(ROWS_PER_RANK * COLUMNS);
+
+    h5::dimensions offset, count;
+    offset.push_back(other * ROWS_PER_RANK);
+    offset.push_back(0);
+    count.push_back(ROWS_PER_RANK);
+    count.push_back(COLUMNS);
+
+    check(dset.read_hyperslab<float>(&rows[0], offset, count), "Collective read");
+
+    for (int r = 0; r < ROWS_PER_RANK; r++)
+        for (int c = 0; c < COLUMNS; c++)
+        {
+            const int row = other * ROWS_PER_RANK + r;
+            check(rows[r * COLUMNS + c] == value(row, c), "Read value");
+        }
+
+    // A column-major layout takes one transfer per row here, and each rank
+    // reads a different number of rows: the others get padded with empty
+    // collective transfers
+    count[0] = rank + 1;
+    offset[0] = 0;
+    std::vector<float> columns(count[0] * COLUMNS);
+    h5::MemoryLayout layout = h5::MemoryLayout::column_major(count);
+    check(dset.read_hyperslab<float>(&columns[0], offset, count, &layout), "Uneven collective reads");
+
+    for (int r = 0; r < count[0]; r++)
+        for (int c = 0; c < COLUMNS; c++)
+            check(columns[c * count[0] + r] == value(r, c), "Column-major value");
+
+    dset.set_collective(false);
+    check(!dset.is_collective(), "Switch to independent");
+
+    float first[COLUMNS];
+    count[0] = 1;
+    offset[0] = rank;
+    check(dset.read_hyperslab<float>(first, offset, count), "Independent read");
+    check(first[COLUMNS-1] == value(rank, COLUMNS-1), "Independent read value");
+}
+
+int
+main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    if (--argc != 1)
+    {
+        if (rank == 0)
+        {
+            printf("usage: %s file.hdf5\n", argv[0]);
+            printf("\n");
+            printf("Note that file.hdf5 will be overwritten if it exists!\n");
+            printf("\n");
+        }
+        MPI_Finalize();
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    if (rank == 0)
+        printf("All tests passed (%d processes)\n", size);
+
+    MPI_Finalize();
+
+    return 0;
+}
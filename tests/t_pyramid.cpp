@@ -0,0 +1,289 @@
+#include <cstdlib>
+#include <cmath>
+#include "uhdf5.h"
+#include "check.h"
+
+const int ROWS = 1000;
+const int COLUMNS = 1200;
+
+// Partial blocks at the far edges get combined with whole ones
+const int EDGE_ROWS = 12;
+const int EDGE_COLUMNS = 20;
+
+const int DEPTH = 64;
+const int HEIGHT = 80;
+const int WIDTH = 90;
+
+float
+image(int row, int col)
+{
+    return (row * 7 + col * 3) % 101 + 0.25f * (col % 4);
+}
+
+int32_t
+edges(int row, int col)
+{
+    return (row * 37 + col * 11) % 50;
+}
+
+uint16_t
+volume(int z, int y, int x)
+{
+    return (z * 131 + y * 17 + x * 29) % 1000;
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.create(fname), "File creation");
+
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    std::vector<float> values(ROWS * COLUMNS);
+    for (int r = 0; r < ROWS; r++)
+        for (int c = 0; c < COLUMNS; c++)
+            values[r * COLUMNS + c] = image(r, c);
+
+    h5::DatasetCreationOptions options;
+    options.chunk_dims.push_back(96);
+    options.chunk_dims.push_back(96);
+    check(file.create_dataset<float>("/image", dims, options, dset), "Image creation");
+    check(dset.write<float>(&values[0]), "Image write");
+    check(file.create_dataset<float>("/decimated", dims, options, dset), "Image creation");
+    check(dset.write<float>(&values[0]), "Image write");
+
+    dims.clear();
+    dims.push_back(DEPTH);
+    dims.push_back(HEIGHT);
+    dims.push_back(WIDTH);
+
+    std::vector<uint16_t> voxels(DEPTH * HEIGHT * WIDTH);
+    for (int z = 0; z < DEPTH; z++)
+        for (int y = 0; y < HEIGHT; y++)
+            for (int x = 0; x < WIDTH; x++)
+                voxels[(z * HEIGHT + y) * WIDTH + x] = volume(z, y, x);
+
+    check(file.create_dataset<uint16_t>("/volume", dims, h5::DatasetCreationOptions(), dset), "Volume creation");
+    check(dset.write<uint16_t>(&voxels[0]), "Volume write");
+
+    dims.clear();
+    dims.push_back(EDGE_ROWS);
+    dims.push_back(EDGE_COLUMNS);
+
+    std::vector<int32_t> edge_values(EDGE_ROWS * EDGE_COLUMNS);
+    for (int r = 0; r < EDGE_ROWS; r++)
+        for (int c = 0; c < EDGE_COLUMNS; c++)
+            edge_values[r * EDGE_COLUMNS + c] = edges(r, c);
+
+    check(file.create_dataset<int32_t>("/edges", dims, h5::DatasetCreationOptions(), dset), "Edges creation");
+    check(dset.write<int32_t>(&edge_values[0]), "Edges write");
+
+    // In the way of level 3, so levels 1 and 2 get removed again
+    check(file.create_dataset<int32_t>("/edges_level3", dims, h5::DatasetCreationOptions(), dset), "Blocker creation");
+    dset.close();
+
+    // Small budget, for many slabs: 16 rows (for 4 levels) fit, but not
+    // the 96 rows that would also align to the chunks
+    h5::PyramidOptions pyramid_options;
+    pyramid_options.min_size = 100;
+    pyramid_options.memory_budget = 512*1024;
+    check(h5::Pyramid::build<float>(file, "/image", pyramid_options), "Image pyramid");
+
+    // Not even 16 rows fit, which takes more than the budget
+    pyramid_options.method = h5::PyramidOptions::METHOD_DECIMATE;
+    pyramid_options.memory_budget = 1024;
+    check(h5::Pyramid::build<float>(file, "/decimated", pyramid_options), "Decimated pyramid");
+
+    pyramid_options.method = h5::PyramidOptions::METHOD_MAX;
+    pyramid_options.factor = 3;
+    pyramid_options.min_size = 10;
+    check(h5::Pyramid::build<uint16_t>(file, "/volume", pyramid_options), "Volume pyramid");
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    check(!h5::Pyramid::build<float>(file, "/image", pyramid_options), "Building twice");
+
+    h5::PyramidOptions edge_options;
+    edge_options.min_size = 1;
+    check(!h5::Pyramid::build<int32_t>(file, "/edges", edge_options), "Blocked pyramid");
+    H5Eset_auto2(H5E_DEFAULT, (H5E_auto2_t)H5Eprint2, stderr);
+
+    check(!file.exists("/edges_level1") && !file.exists("/edges_level2"), "Failed levels removed");
+    check(file.open_dataset("/edges", dset), "Edges open");
+    check(!dset.has_attribute("pyramid") && !dset.has_attribute("pyramid_method"), "Failed attributes removed");
+    dset.close();
+
+    check(H5Ldelete(file.get_id(), "/edges_level3", H5P_DEFAULT) >= 0, "Blocker removal");
+    check(h5::Pyramid::build<int32_t>(file, "/edges", edge_options), "Edges pyramid");
+}
+
+void
+check_image(h5::Pyramid& pyramid)
+{
+    check(pyramid.get_num_levels() == 5 && pyramid.get_factor() == 2, "Image levels");
+
+    // Reference, the means of the full resolution blocks
+    int rows = ROWS, columns = COLUMNS;
+    for (int level = 1, scale = 2; level < 5; level++, scale *= 2)
+    {
+        rows = (rows + 1) / 2;
+        columns = (columns + 1) / 2;
+
+        std::vector<float> expected(rows * columns);
+        for (int r = 0; r < rows; r++)
+            for (int c = 0; c < columns; c++)
+            {
+                double  sum = 0;
+                int     n = 0;
+                for (int i = r * scale; i < std::min((r + 1) * scale, ROWS); i++)
+                    for (int j = c * scale; j < std::min((c + 1) * scale, COLUMNS); j++, n++)
+                        sum += image(i, j);
+                expected[r * columns + c] = (float)(sum / n);
+            }
+
+        h5::dimensions dims;
+        pyramid.get_dimensions(level, dims);
+        check(dims[0] == rows && dims[1] == columns, "Image level dimensions");
+
+        std::vector<float> values(rows * columns);
+        check(pyramid.get_level(level).read<float>(&values[0]), "Image level read");
+        for (int i = 0; i < rows * columns; i++)
+            check(values[i] == expected[i], "Image level values");
+    }
+}
+
+void
+check_edges(h5::Pyramid& pyramid)
+{
+    check(pyramid.get_num_levels() == 6, "Edges levels");
+
+    // Level 4 has one row, from level 3 rows covering 8 and 4 rows: a
+    // plain mean of those two would weigh rows 8-11 twice
+    for (int level = 1, scale = 2; level < pyramid.get_num_levels(); level++, scale *= 2)
+    {
+        h5::dimensions dims;
+        pyramid.get_dimensions(level, dims);
+        check(dims[0] == (EDGE_ROWS + scale - 1) / scale && dims[1] == (EDGE_COLUMNS + scale - 1) / scale,
+            "Edges level dimensions");
+
+        std::vector<int32_t> values(dims[0] * dims[1]);
+        check(pyramid.get_level(level).read<int32_t>(&values[0]), "Edges level read");
+
+        for (int r = 0; r < dims[0]; r++)
+            for (int c = 0; c < dims[1]; c++)
+            {
+                double  sum = 0;
+                int     n = 0;
+                for (int i = r * scale; i < std::min((r + 1) * scale, EDGE_ROWS); i++)
+                    for (int j = c * scale; j < std::min((c + 1) * scale, EDGE_COLUMNS); j++, n++)
+                        sum += edges(i, j);
+
+                check(values[r * dims[1] + c] == (int32_t)std::floor(sum / n + 0.5), "Edges level values");
+            }
+    }
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File        file;
+    h5::FileOptions options;
+    h5::IOMonitor   monitor;
+    h5::Pyramid     pyramid;
+
+    options.io_monitor = &monitor;
+    check(file.open(fname, true, options), "File open");
+
+    check(pyramid.open(file, "/image"), "Image pyramid open");
+    check_image(pyramid);
+
+    // Overview of the whole image, and a zoomed-in region
+    h5::dimensions offset(2, 0), count, resolution(2, 100), dims;
+    count.push_back(ROWS);
+    count.push_back(COLUMNS);
+
+    std::vector<float> values, level_values;
+
+    monitor.reset();
+    check(pyramid.read_region<float>(offset, count, resolution, values, dims) == 3, "Overview level");
+    check(dims[0] == 125 && dims[1] == 150, "Overview dimensions");
+    check(monitor.bytes_read < 256*1024, "Overview bytes read");
+
+    level_values.resize(125 * 150);
+    check(pyramid.get_level(3).read<float>(&level_values[0]), "Level read");
+    check(values == level_values, "Overview values");
+
+    offset[0] = 101;
+    offset[1] = 203;
+    count[0] = 300;
+    count[1] = 250;
+    check(pyramid.read_region<float>(offset, count, resolution, values, dims) == 1, "Region level");
+    check(dims[0] == 151 && dims[1] == 126, "Region dimensions");
+
+    resolution[0] = 1000;
+    check(pyramid.read_region<float>(offset, count, resolution, values, dims) == 0, "Full resolution level");
+    check(dims[0] == 300 && dims[1] == 250 && values[0] == image(101, 203), "Full resolution region");
+
+    check(pyramid.open(file, "/edges"), "Edges pyramid open");
+    check_edges(pyramid);
+
+    // Decimated: element i of level k is element i*2^k of the image
+    check(pyramid.open(file, "/decimated"), "Decimated pyramid open");
+    for (int level = 1, scale = 2; level < pyramid.get_num_levels(); level++, scale *= 2)
+    {
+        pyramid.get_dimensions(level, dims);
+        values.resize(dims[0] * dims[1]);
+        check(pyramid.get_level(level).read<float>(&values[0]), "Decimated level read");
+
+        for (int r = 0; r < dims[0]; r++)
+            for (int c = 0; c < dims[1]; c++)
+                check(values[r * dims[1] + c] == image(r * scale, c * scale), "Decimated values");
+    }
+
+    // Maxima of maxima are the maxima of the full resolution blocks
+    check(pyramid.open(file, "/volume"), "Volume pyramid open");
+    check(pyramid.get_num_levels() == 3 && pyramid.get_factor() == 3, "Volume levels");
+    for (int level = 1, scale = 3; level < pyramid.get_num_levels(); level++, scale *= 3)
+    {
+        pyramid.get_dimensions(level, dims);
+        std::vector<uint16_t> voxels(dims[0] * dims[1] * dims[2]);
+        check(pyramid.get_level(level).read<uint16_t>(&voxels[0]), "Volume level read");
+
+        for (int z = 0; z < dims[0]; z++)
+            for (int y = 0; y < dims[1]; y++)
+                for (int x = 0; x < dims[2]; x++)
+                {
+                    uint16_t maximum = 0;
+                    for (int i = z * scale; i < std::min((z + 1) * scale, DEPTH); i++)
+                        for (int j = y * scale; j < std::min((y + 1) * scale, HEIGHT); j++)
+                            for (int k = x * scale; k < std::min((x + 1) * scale, WIDTH); k++)
+                                maximum = std::max(maximum, volume(i, j, k));
+
+                    check(voxels[(z * dims[1] + y) * dims[2] + x] == maximum, "Volume values");
+                }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
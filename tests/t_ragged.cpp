@@ -0,0 +1,115 @@
+#include <cstdlib>
+#include "uhdf5.h"
+#include "check.h"
+
+const int NUM_ITEMS = 100000;
+
+// Includes empty items
+int
+item_size(int item)
+{
+    return (item * 7) % 23;
+}
+
+float
+value(int item, int i)
+{
+    return item + 0.001f * i;
+}
+
+void
+append_items(h5::RaggedArray<float>& array, int first, int last)
+{
+    std::vector<float> values;
+
+    for (int item = first; item < last; item++)
+    {
+        values.resize(item_size(item));
+        for (int i = 0; i < item_size(item); i++)
+            values[i] = value(item, i);
+
+        check(array.append(values.empty() ? NULL : &values[0], values.size()), "Append");
+    }
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File                file;
+    h5::RaggedArray<float>  array;
+
+    check(file.create(fname), "File creation");
+    check(array.create(file, "/events", 4096), "Ragged array creation");
+
+    append_items(array, 0, NUM_ITEMS / 2);
+
+    // Reading flushes appended items
+    std::vector<float> values;
+    check(array.read(NUM_ITEMS / 2 - 1, values), "Read while appending");
+    check((int)values.size() == item_size(NUM_ITEMS / 2 - 1), "Item size while appending");
+
+    append_items(array, NUM_ITEMS / 2, NUM_ITEMS - 100);
+    check(array.close(), "Close");
+
+    // Reopen and append the rest
+    check(array.open(file, "/events"), "Open for appending");
+    check(array.get_num_items() == NUM_ITEMS - 100, "Number of items after reopening");
+    append_items(array, NUM_ITEMS - 100, NUM_ITEMS);
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File                file;
+    h5::RaggedArray<float>  array;
+    std::vector<float>      values;
+    std::vector<hsize_t>    offsets;
+
+    check(file.open(fname, true), "File open");
+    check(array.open(file, "/events"), "Ragged array open");
+    check(array.get_num_items() == NUM_ITEMS, "Number of items");
+
+    for (int item = 0; item < NUM_ITEMS; item += 997)
+    {
+        check((int)array.get_item_size(item) == item_size(item), "Item size");
+        check(array.read(item, values), "Item read");
+        check((int)values.size() == item_size(item), "Item read size");
+        for (int i = 0; i < item_size(item); i++)
+            check(values[i] == value(item, i), "Item value");
+    }
+
+    const int first = 12345, count = 1000;
+
+    check(array.read_range(first, count, values, offsets), "Range read");
+    check(offsets.size() == count + 1 && offsets[0] == 0 && offsets[count] == values.size(), "Range offsets");
+    for (int j = 0; j < count; j++)
+    {
+        const int item = first + j;
+        check((int)(offsets[j+1] - offsets[j]) == item_size(item), "Range item size");
+        for (int i = 0; i < item_size(item); i++)
+            check(values[offsets[j] + i] == value(item, i), "Range value");
+    }
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    check(!array.read(NUM_ITEMS, values), "Out of range read");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
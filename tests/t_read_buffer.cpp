@@ -0,0 +1,140 @@
+#include <cstdlib>
+#include <cstdint>
+#include "uhdf5.h"
+#include "check.h"
+
+const int STEPS = 10;
+const int ROWS = 300;
+const int COLUMNS = 500;
+
+double
+value(int step, int i)
+{
+    return step * 1000000.0 + i;
+}
+
+// One dataset per time step
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.create(fname), "File creation");
+
+    h5::dimensions dims;
+    dims.push_back(ROWS);
+    dims.push_back(COLUMNS);
+
+    std::vector<double> values(ROWS * COLUMNS);
+    char name[32];
+
+    for (int step = 0; step < STEPS; step++)
+    {
+        for (int i = 0; i < ROWS * COLUMNS; i++)
+            values[i] = value(step, i);
+
+        snprintf(name, sizeof(name), "/step%d", step);
+        check(file.create_dataset<double>(name, dims, h5::DatasetCreationOptions(), dset), "Dataset creation");
+        check(dset.write<double>(&values[0]), "Dataset write");
+    }
+}
+
+void
+check_steps(h5::File& file, h5::ReadBuffer<double>& buffer, size_t alignment)
+{
+    h5::Dataset dset;
+    char        name[32];
+
+    for (int step = 0; step < STEPS; step++)
+    {
+        snprintf(name, sizeof(name), "/step%d", step);
+        check(file.open_dataset(name, dset), "Dataset open");
+        check(dset.read<double>(buffer), "Buffer read");
+
+        check(buffer.size() == ROWS * COLUMNS, "Buffer size");
+        check(buffer.get_dimensions()[0] == ROWS && buffer.get_dimensions()[1] == COLUMNS, "Buffer dimensions");
+        check((uintptr_t)buffer.data() % alignment == 0, "Buffer alignment");
+
+        for (int i = 0; i < ROWS * COLUMNS; i++)
+            check(buffer[i] == value(step, i), "Buffer values");
+    }
+
+    // Allocated once, for the first step
+    check(buffer.get_num_allocations() == 1, "Single allocation");
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.open(fname), "File open");
+
+    h5::ReadBuffer<double> buffer;
+    check_steps(file, buffer, 64);
+
+    // Smaller hyperslabs reuse the memory, larger ones reallocate
+    const double *data = buffer.data();
+    h5::dimensions offset, count;
+    offset.push_back(10);
+    offset.push_back(20);
+    count.push_back(5);
+    count.push_back(7);
+
+    check(file.open_dataset("/step3", dset), "Dataset open");
+    check(dset.read_hyperslab<double>(buffer, offset, count), "Hyperslab read");
+    check(buffer.data() == data && buffer.get_num_allocations() == 1, "Buffer reuse");
+    check(buffer.size() == 35 && buffer.get_dimensions() == count, "Hyperslab size");
+    for (int r = 0; r < 5; r++)
+        for (int c = 0; c < 7; c++)
+            check(buffer[r * 7 + c] == value(3, (10 + r) * COLUMNS + 20 + c), "Hyperslab values");
+
+    // A failed reallocation keeps the buffer and the last read
+    check(!buffer.reserve((size_t)1 << 60), "Impossible size");
+    check(buffer.data() == data && buffer.size() == 35 && buffer.get_dimensions() == count, "Kept after failure");
+    check(buffer[0] == value(3, 10 * COLUMNS + 20), "Kept values");
+
+    check(buffer.reserve(2 * ROWS * COLUMNS) && buffer.get_num_allocations() == 2, "Growing");
+    check(buffer.capacity() >= 2 * ROWS * COLUMNS, "Capacity");
+
+    h5::ReadBuffer<double> odd_buffer(48);
+    check(!odd_buffer.reserve(10), "Alignment not a power of 2");
+
+    // Page aligned, and huge pages with parallel first touch
+    h5::ReadBuffer<double> page_buffer(4096);
+    check_steps(file, page_buffer, 4096);
+
+    h5::ReadBuffer<double> huge_buffer(64, true, 4);
+    check_steps(file, huge_buffer, 2*1024*1024);
+    check(huge_buffer.capacity() * sizeof(double) % (2*1024*1024) == 0, "Whole huge pages");
+
+    // Moving keeps the memory
+    data = huge_buffer.data();
+    h5::ReadBuffer<double> moved(std::move(huge_buffer));
+    check(moved.data() == data && huge_buffer.data() == NULL, "Move");
+
+    moved.release();
+    check(moved.data() == NULL && moved.capacity() == 0, "Release");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include <cstdlib>
+#include <cstdint>
+#include "uhdf5.h"
+#include "check.h"
+
+const int D0 = 40;
+const int D1 = 50;
+const int D2 = 60;
+
+int32_t
+value(int i, int j, int k)
+{
+    return i * 10000 + j * 100 + k;
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.create(fname), "File creation");
+
+    h5::dimensions dims;
+    dims.push_back(D0);
+    dims.push_back(D1);
+    dims.push_back(D2);
+
+    h5::DatasetCreationOptions options;
+    options.layout = h5::DatasetCreationOptions::LAYOUT_CHUNKED;
+    options.chunk_dims.push_back(10);
+    options.chunk_dims.push_back(25);
+    options.chunk_dims.push_back(30);
+    options.compression = h5::DatasetCreationOptions::COMPRESSION_DEFLATE;
+    options.compression_level = 1;
+
+    std::vector<int32_t> values(D0 * D1 * D2);
+    for (int i = 0; i < D0; i++)
+        for (int j = 0; j < D1; j++)
+            for (int k = 0; k < D2; k++)
+                values[(i * D1 + j) * D2 + k] = value(i, j, k);
+
+    check(file.create_dataset<int32_t>("/source", dims, options, dset), "Dataset creation");
+    check(dset.write<int32_t>(&values[0]), "Dataset write");
+}
+
+// Repacks /source to path and checks the values against the source, with
+// destination axis i being source axis order[i]
+void
+repack(h5::File& file, const char *path, const h5::RepackOptions& options, h5::RepackStatistics& stats)
+{
+    h5::Dataset source;
+
+    check(file.open_dataset("/source", source), "Dataset open");
+
+    h5::Dataset *dset = file.repack_dataset(path, &source, options, &stats);
+    check(dset != NULL, "Repacking");
+
+    std::vector<int> order(options.axis_order);
+    if (order.empty())
+    {
+        for (int i = 0; i < 3; i++)
+            order.push_back(i);
+    }
+
+    const int src_dims[3] = { D0, D1, D2 };
+    h5::dimensions dims;
+    dset->get_dimensions(dims);
+    for (int i = 0; i < 3; i++)
+        check(dims[i] == src_dims[order[i]], "Repacked dimensions");
+
+    h5::dimensions chunk_dims;
+    if (options.chunk_dims.empty())
+        check(!dset->get_chunk_dimensions(chunk_dims), "Contiguous layout");
+    else
+        check(dset->get_chunk_dimensions(chunk_dims) && chunk_dims == options.chunk_dims, "Chunk dimensions");
+
+    std::vector<int32_t> values(D0 * D1 * D2);
+    check(dset->read<int32_t>(&values[0]), "Dataset read");
+
+    int index[3];
+    for (index[0] = 0; index[0] < dims[0]; index[0]++)
+        for (index[1] = 0; index[1] < dims[1]; index[1]++)
+            for (index[2] = 0; index[2] < dims[2]; index[2]++)
+            {
+                int src[3];
+                for (int i = 0; i < 3; i++)
+                    src[order[i]] = index[i];
+
+                check(values[(index[0] * dims[1] + index[1]) * dims[2] + index[2]] == value(src[0], src[1], src[2]),
+                    "Repacked values");
+            }
+
+    delete dset;
+
+    check(stats.bytes == (hsize_t)D0 * D1 * D2 * sizeof(int32_t), "Bytes copied");
+    check(stats.slabs >= 1 && stats.seconds >= 0 && stats.throughput > 0, "Statistics");
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File                file;
+    h5::RepackOptions       options;
+    h5::RepackStatistics    stats;
+
+    check(file.open(fname), "File open");
+
+    // Same shape, contiguous, in one slab
+    repack(file, "/contiguous", options, stats);
+    check(stats.slabs == 1, "Single slab");
+
+    // Other chunk shape, compressed
+    options.chunk_dims.push_back(40);
+    options.chunk_dims.push_back(5);
+    options.chunk_dims.push_back(7);
+    options.enable_deflate_compression = true;
+    options.deflate_level = 1;
+    repack(file, "/rechunked", options, stats);
+
+    // Transposed: destination (D2, D0, D1), in slabs of whole source and
+    // destination chunks (30 x 10 x 50 values), two at a time: 30 x 20 x 50
+    options.axis_order.push_back(2);
+    options.axis_order.push_back(0);
+    options.axis_order.push_back(1);
+    options.chunk_dims[0] = 15;
+    options.chunk_dims[1] = 10;
+    options.chunk_dims[2] = 50;
+    options.memory_budget = 2 * 30 * 10 * 50 * 2 * sizeof(int32_t);
+    repack(file, "/transposed", options, stats);
+    check(stats.slabs == 4, "Chunk-aligned slabs");
+
+    // Budget below one row of source chunks (10 x 25 x 60 values), so
+    // slabs are not aligned to the source chunks
+    options.memory_budget = 4096;
+    printf("Expect a warning below\n");
+    repack(file, "/small_budget", options, stats);
+    check(stats.slabs > 100 && stats.bytes / stats.slabs <= 4096 / 2, "Slabs within budget");
+
+    // Invalid axis orders are rejected
+    h5::Dataset source;
+    check(file.open_dataset("/source", source), "Dataset open");
+    options.axis_order[0] = 1;
+    printf("Expect an error below\n");
+    check(file.repack_dataset("/invalid", &source, options) == NULL, "Invalid axis order");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <cstdlib>
+#include <cstdint>
+#include "uhdf5.h"
+#include "check.h"
+
+const int COLUMNS = 7;
+
+int32_t
+value(int row, int column)
+{
+    return row * 100 + column;
+}
+
+// Writes all shards of a rows x COLUMNS dataset and the master file
+void
+write_sharded(const char *fname, int rows, int num_shards)
+{
+    h5::dimensions dims;
+    dims.push_back(rows);
+    dims.push_back(COLUMNS);
+
+    h5::ShardedWriter writer(fname, "/data", dims, num_shards);
+    check(writer.get_num_shards() == num_shards, "Number of shards");
+
+    for (int i = 0; i < num_shards; i++)
+    {
+        h5::File        file;
+        h5::Dataset     dset;
+        std::string     shard_fname;
+        h5::dimensions  offset, count;
+
+        check(writer.get_shard(i, shard_fname, offset, count), "Shard layout");
+        check(writer.create_shard<int32_t>(i, file, dset), "Shard creation");
+
+        std::vector<int32_t> values(count[0] * COLUMNS + 1);
+        for (int r = 0; r < count[0]; r++)
+            for (int c = 0; c < COLUMNS; c++)
+                values[r * COLUMNS + c] = value(offset[0] + r, c);
+
+        if (count[0] > 0)
+            check(dset.write<int32_t>(&values[0]), "Shard write");
+    }
+
+    check(writer.create_master<int32_t>(), "Master creation");
+}
+
+void
+read_sharded(const char *fname, int rows)
+{
+    h5::File        file;
+    h5::Dataset     dset;
+    h5::dimensions  dims;
+
+    check(file.open(fname, true), "File open");
+    check(file.open_dataset("/data", dset), "Dataset open");
+
+    dset.get_dimensions(dims);
+    check(dims.size() == 2 && dims[0] == rows && dims[1] == COLUMNS, "Master dimensions");
+
+    std::vector<int32_t> values(rows * COLUMNS);
+    check(dset.read<int32_t>(&values[0]), "Master read");
+
+    for (int r = 0; r < rows; r++)
+        for (int c = 0; c < COLUMNS; c++)
+            check(values[r * COLUMNS + c] == value(r, c), "Master values");
+
+    // Rows 4 to 8, across the first shard boundary
+    h5::dimensions offset, count;
+    offset.push_back(4);
+    offset.push_back(2);
+    count.push_back(5);
+    count.push_back(3);
+
+    std::vector<int32_t> block(5 * 3);
+    check(dset.read_hyperslab<int32_t>(&block[0], offset, count), "Hyperslab read");
+    for (int r = 0; r < 5; r++)
+        for (int c = 0; c < 3; c++)
+            check(block[r * 3 + c] == value(4 + r, 2 + c), "Hyperslab values");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 (and its shard files) will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    // 23 rows in shards of 6 rows, the last one holding 5
+    write_sharded(argv[1], 23, 4);
+    read_sharded(argv[1], 23);
+
+    // 10 rows in shards of 3 rows, the last one holding 1
+    write_sharded(argv[1], 10, 4);
+    read_sharded(argv[1], 10);
+
+    // 9 rows in shards of 3 rows, the last shard being empty
+    write_sharded(argv[1], 9, 4);
+    read_sharded(argv[1], 9);
+
+    // Shards are found relative to the master file
+    if (argv[1][0] == '/')
+    {
+        check(chdir("/") == 0, "Changing directory");
+        read_sharded(argv[1], 9);
+    }
+
+    // Rank 0 has no shards
+    h5::ShardedWriter writer(argv[1], "/data", h5::dimensions(), 4);
+    check(writer.get_num_shards() == 0 && !writer.create_master<int32_t>(), "Rank 0 rejected");
+
+    printf("All tests passed\n");
+
+    return 0;
+}
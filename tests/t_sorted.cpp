@@ -0,0 +1,160 @@
+#include <cstdlib>
+#include <algorithm>
+#include "uhdf5.h"
+#include "check.h"
+
+const int SIZE = 2000000;
+const int LOOKUPS = 1000;
+
+// Sorted, with runs of duplicates and gaps
+void
+make_keys(std::vector<int64_t>& keys)
+{
+    keys.resize(SIZE);
+
+    int64_t key = 0;
+    for (int i = 0; i < SIZE; i++)
+    {
+        if (i % 7 == 0)
+            key += 1 + i % 5;
+        keys[i] = key;
+    }
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File    file;
+    h5::Dataset dset;
+
+    check(file.create(fname), "File creation");
+
+    std::vector<int64_t> keys;
+    make_keys(keys);
+
+    h5::dimensions dims(1, SIZE);
+
+    h5::DatasetCreationOptions chunked;
+    chunked.chunk_dims.push_back(8192);
+    check(file.create_dataset<int64_t>("/chunked", dims, chunked, dset), "Chunked dataset creation");
+    check(dset.write<int64_t>(&keys[0]), "Chunked dataset write");
+
+    // Chunks larger than the probe blocks
+    h5::DatasetCreationOptions large;
+    large.chunk_dims.push_back(300000);
+    check(file.create_dataset<int64_t>("/large_chunks", dims, large, dset), "Large chunks dataset creation");
+    check(dset.write<int64_t>(&keys[0]), "Large chunks dataset write");
+
+    std::vector<double> times(SIZE);
+    for (int i = 0; i < SIZE; i++)
+        times[i] = keys[i] * 0.5;
+
+    h5::DatasetCreationOptions contiguous;
+    contiguous.layout = h5::DatasetCreationOptions::LAYOUT_CONTIGUOUS;
+    check(file.create_dataset<double>("/contiguous", dims, contiguous, dset), "Contiguous dataset creation");
+    check(dset.write<double>(&times[0]), "Contiguous dataset write");
+
+    h5::dimensions dims2(2, 10);
+    check(file.create_dataset<int64_t>("/2d", dims2, h5::DatasetCreationOptions(), dset), "2-D dataset creation");
+}
+
+template <typename T>
+void
+check_lookups(h5::Dataset& dset, const std::vector<T>& values)
+{
+    srand(1);
+
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        // Also below the first and past the last
+        T value = (T)(rand() % (int)(values.back() + 20) - 10);
+
+        hsize_t first, last, lower, upper;
+        check(dset.equal_range<T>(value, first, last), "Equal range");
+        check(dset.lower_bound<T>(value, lower) && dset.upper_bound<T>(value, upper), "Bounds");
+
+        typename std::vector<T>::const_iterator begin = values.begin();
+        hsize_t expected_first = std::lower_bound(begin, values.end(), value) - begin;
+        hsize_t expected_last = std::upper_bound(begin, values.end(), value) - begin;
+
+        check(first == expected_first && lower == expected_first, "Lower bound");
+        check(last == expected_last && upper == expected_last, "Upper bound");
+    }
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File        file;
+    h5::FileOptions options;
+    h5::IOMonitor   monitor;
+    h5::Dataset     dset;
+
+    options.io_monitor = &monitor;
+    check(file.open(fname, false, options), "File open");
+
+    std::vector<int64_t> keys;
+    make_keys(keys);
+
+    std::vector<double> times(SIZE);
+    for (int i = 0; i < SIZE; i++)
+        times[i] = keys[i] * 0.5;
+
+    // A cold lookup reads a few chunks, not the dataset
+    check(file.open_dataset("/chunked", dset), "Chunked dataset open");
+    monitor.reset();
+    hsize_t first, last;
+    check(dset.equal_range<int64_t>(keys[SIZE / 3], first, last), "Cold lookup");
+    check(first <= (hsize_t)SIZE / 3 && (hsize_t)SIZE / 3 < last, "Cold lookup result");
+    check(monitor.bytes_read < SIZE * sizeof(int64_t) / 8, "Bytes read by lookup");
+
+    // The same lookup again is served from the probe cache
+    monitor.reset();
+    check(dset.equal_range<int64_t>(keys[SIZE / 3], first, last), "Cached lookup");
+    check(monitor.reads == 0, "No reads for cached lookup");
+
+    check_lookups<int64_t>(dset, keys);
+
+    // Read in windows within large chunks
+    check(file.open_dataset("/large_chunks", dset), "Large chunks dataset open");
+    monitor.reset();
+    check(dset.equal_range<int64_t>(keys[SIZE / 3], first, last), "Cold lookup in large chunks");
+    check(first <= (hsize_t)SIZE / 3 && (hsize_t)SIZE / 3 < last, "Cold lookup result in large chunks");
+    check(monitor.bytes_read < monitor.reads * 300000 * sizeof(int64_t), "Less than a chunk per read");
+    check_lookups<int64_t>(dset, keys);
+
+    // Writes drop the cache
+    h5::dimensions offset(1, 0), count(1, 1);
+    int64_t lowest = -100;
+    check(dset.write_hyperslab<int64_t>(&lowest, offset, count), "Write");
+    keys[0] = lowest;
+    check_lookups<int64_t>(dset, keys);
+
+    check(file.open_dataset("/contiguous", dset), "Contiguous dataset open");
+    check_lookups<double>(dset, times);
+
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+
+    check(file.open_dataset("/2d", dset), "2-D dataset open");
+    check(!dset.lower_bound<int64_t>(0, first), "Bisect 2-D dataset");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
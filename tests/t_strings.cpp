@@ -0,0 +1,152 @@
+#include <cstdlib>
+#include <string>
+#include "uhdf5.h"
+#include "check.h"
+
+const int N = 100000;
+
+// Up to 15 bytes, including empty strings
+std::string
+label(int i)
+{
+    return std::string("label") + std::to_string(i * 7919).substr(0, i % 11);
+}
+
+void
+write_file(const char *fname)
+{
+    h5::File        file;
+    h5::Dataset     dset;
+    h5::Attribute   attr;
+
+    check(file.create(fname), "File creation");
+
+    std::vector<std::string> labels;
+    for (int i = 0; i < N; i++)
+        labels.push_back(label(i));
+
+    h5::dimensions dims;
+    dims.push_back(N);
+
+    h5::DatasetCreationOptions options;
+    options.compression = h5::DatasetCreationOptions::COMPRESSION_DEFLATE;
+
+    check(file.create_string_dataset("/variable", dims, 0, options, dset), "Variable-length dataset creation");
+    check(dset.write_strings(labels), "Variable-length dataset write");
+
+    check(file.create_string_dataset("/fixed", dims, 16, options, dset), "Fixed-length dataset creation");
+    check(dset.write_strings(labels), "Fixed-length dataset write");
+
+    // Exactly filling the fixed length, without terminating NUL, as the
+    // strings are NUL-padded
+    h5::dimensions adims;
+    adims.push_back(2);
+
+    std::vector<std::string> names;
+    names.push_back("abcd");
+    names.push_back("");
+    check(dset.create_string_attribute("names", adims, 0, attr), "Variable-length attribute creation");
+    check(attr.write_strings(names), "Variable-length attribute write");
+
+    names[1] = "efgh";
+    check(dset.create_string_attribute("units", adims, 4, attr), "Fixed-length attribute creation");
+    check(attr.write_strings(names), "Fixed-length attribute write");
+
+    names[0] = "too long";
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    check(!attr.write_strings(names), "Too long string write");
+    names.pop_back();
+    check(!attr.write_strings(names), "Wrong number of strings write");
+
+    // NUL-terminated strings (e.g. made by other tools) need room for the NUL
+    hid_t   type_id = H5Tcopy(H5T_C_S1);
+    hid_t   space_id = H5Screate_simple(1, (const hsize_t[]){ 2 }, NULL);
+    H5Tset_size(type_id, 4);
+    H5Tset_strpad(type_id, H5T_STR_NULLTERM);
+    hid_t   attr_id = H5Acreate2(dset.get_id(), "terminated", type_id, space_id, H5P_DEFAULT, H5P_DEFAULT);
+    check(attr_id >= 0, "NUL-terminated attribute creation");
+    attr = h5::Attribute(&dset, attr_id);
+    H5Sclose(space_id);
+    H5Tclose(type_id);
+
+    names[0] = "abcd";
+    names.push_back("efg");
+    check(!attr.write_strings(names), "No room for the NUL");
+    names[0] = "abc";
+    check(attr.write_strings(names), "NUL-terminated attribute write");
+
+    check(file.create_dataset<float>("/numbers", dims, h5::DatasetCreationOptions(), dset), "Numbers dataset creation");
+}
+
+void
+check_labels(h5::StringTable& strings)
+{
+    check(strings.size() == N, "Number of strings");
+    for (int i = 0; i < N; i++)
+    {
+        check(strings.get_length(i) == label(i).size(), "String length");
+        check(strings.get_string(i) == label(i), "String value");
+        check(strings.get(i)[strings.get_length(i)] == '\0', "Terminating NUL");
+    }
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File        file;
+    h5::Dataset     dset;
+    h5::Attribute   attr;
+    h5::StringTable strings;
+
+    check(file.open(fname, true), "File open");
+
+    check(file.open_dataset("/variable", dset), "Variable-length dataset open");
+    check(dset.read_strings(strings), "Variable-length dataset read");
+    check_labels(strings);
+
+    check(file.open_dataset("/fixed", dset), "Fixed-length dataset open");
+    check(dset.read_strings(strings), "Fixed-length dataset read");
+    check_labels(strings);
+
+    check(dset.get_attribute("names", attr), "Variable-length attribute open");
+    check(attr.read_strings(strings), "Variable-length attribute read");
+    check(strings.size() == 2 && strings.get_string(0) == "abcd" && strings.get_string(1) == "", "Variable-length attribute values");
+
+    check(dset.get_attribute("units", attr), "Fixed-length attribute open");
+    check(attr.read_strings(strings), "Fixed-length attribute read");
+    check(strings.size() == 2 && strings.get_string(0) == "abcd" && strings.get_string(1) == "efgh", "Fixed-length attribute values");
+
+    h5::Type type;
+    check(attr.get_type(type) && H5Tget_strpad(type.get_id()) == H5T_STR_NULLPAD, "NUL-padded type");
+
+    // Moving keeps the strings in place
+    h5::StringTable moved(std::move(strings));
+    check(moved.size() == 2 && strcmp(moved.get(1), "efgh") == 0 && strings.size() == 0, "Move");
+
+    check(dset.get_attribute("terminated", attr), "NUL-terminated attribute open");
+    check(attr.read_strings(strings), "NUL-terminated attribute read");
+    check(strings.size() == 2 && strings.get_string(0) == "abc" && strings.get_string(1) == "efg", "NUL-terminated attribute values");
+
+    check(file.open_dataset("/numbers", dset), "Numbers dataset open");
+    check(!dset.read_strings(strings), "Numbers read as strings");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    write_file(argv[1]);
+    read_file(argv[1]);
+
+    printf("All tests passed\n");
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "uhdf5.h"
+#include "check.h"
+
+// A writer process appends rows to a dataset, while this process
+// follows along as a SWMR reader
+
+const int ROWS = 100;
+const int ROWS_PER_WRITE = 7;
+const int M = 4;
+
+void
+write_file(const char *fname)
+{
+    h5::File            file;
+    h5::Dataset         dset;
+    h5::FileOptions     options;
+
+    options.swmr = true;
+    check(file.create(fname, true, options), "SWMR file creation");
+
+    h5::DatasetCreationOptions dset_options;
+    h5::dimensions dims;
+    dims.push_back(0);
+    dims.push_back(M);
+    dset_options.max_dims = dims;
+    dset_options.max_dims[0] = h5::UNLIMITED;
+    dset_options.chunk_dims.push_back(16);
+    dset_options.chunk_dims.push_back(M);
+
+    check(file.create_dataset<int32_t>("/rows", dims, dset_options, dset), "Dataset creation");
+
+    // Nothing to follow in a scalar
+    hid_t   space_id = H5Screate(H5S_SCALAR);
+    hid_t   scalar_id = H5Dcreate2(file.get_id(), "/scalar", H5T_NATIVE_INT32, space_id, H5P_DEFAULT, H5P_DEFAULT,
+        H5P_DEFAULT);
+    check(scalar_id >= 0, "Scalar dataset creation");
+    H5Dclose(scalar_id);
+    H5Sclose(space_id);
+    check(file.start_swmr_write(), "Starting SWMR write");
+
+    h5::BufferedWriter writer(&dset);
+    int32_t values[ROWS_PER_WRITE*M];
+
+    for (int row = 0; row < ROWS; row += ROWS_PER_WRITE)
+    {
+        int n = std::min(ROWS_PER_WRITE, ROWS - row);
+        for (int i = 0; i < n*M; i++)
+            values[i] = row*M + i;
+
+        check(writer.write<int32_t>(values, n), "Write");
+        check(writer.flush() && dset.flush(), "Flush");
+
+        usleep(10000);
+    }
+}
+
+void
+read_file(const char *fname)
+{
+    h5::File            file;
+    h5::Dataset         dset;
+    h5::FileOptions     options;
+
+    options.swmr = true;
+
+    // Wait for the writer to switch to SWMR mode
+    H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    for (int i = 0; i < 500 && !file.open(fname, true, options); i++)
+        usleep(10000);
+
+    check(file.open_dataset("/rows", dset), "SWMR open");
+
+    std::vector<int32_t> values;
+    hsize_t rows = 0;
+    int reads = 0;
+
+    while (rows < ROWS)
+    {
+        hsize_t n = dset.read_new_rows<int32_t>(values, rows, 5.0);
+        check(n > 0, "Waiting for new rows");
+
+        for (hsize_t i = 0; i < n*M; i++)
+            check(values[i] == (int32_t)(rows*M + i), "Row value");
+
+        rows += n;
+        reads++;
+    }
+
+    printf("Read %llu rows in %d steps\n", (unsigned long long)rows, reads);
+
+    check(file.open_dataset("/scalar", dset), "Scalar dataset open");
+    check(dset.wait_for_rows(0, 5.0) == 0, "Scalar has no rows");
+    check(dset.read_new_rows<int32_t>(values, 0, 5.0) == 0 && values.empty(), "Scalar has no new rows");
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (--argc != 1)
+    {
+        printf("usage: %s file.hdf5\n", argv[0]);
+        printf("\n");
+        printf("Note that file.hdf5 will be overwritten if it exists!\n");
+        printf("\n");
+        exit(-1);
+    }
+
+    unlink(argv[1]);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        write_file(argv[1]);
+        exit(0);
+    }
+
+    read_file(argv[1]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "Writer");
+
+    printf("OK\n");
+}
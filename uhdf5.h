@@ -26,26 +26,390 @@ IN THE SOFTWARE.
 */
 
 #include <hdf5.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <list>
+#include <map>
+#include <set>
+#include <type_traits>
+
+// Built-in LZ4 and Zstandard filters, see DatasetCreationOptions::Compression
+#ifdef UHDF5_WITH_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef UHDF5_WITH_ZSTD
+#include <zstd.h>
+#endif
 
 namespace h5
 {
 
 typedef std::vector<int>    dimensions;
 
+// Maximum dimension of an appendable axis
+const int UNLIMITED = -1;
+
 class Type;
 class File;
 class Group;
 class Dataset;
 class Attribute;
 
+//
+// All objects below own their HDF5 id and close it when destroyed.
+// They can be moved (transferring ownership), but not copied. Besides the
+// functions returning heap-allocated objects, which the caller needs to
+// delete, there are variants that fill in an object passed by reference.
+// These need no heap allocation, e.g. in loops opening many objects.
+//
+
+// Native (in-memory) HDF5 type corresponding to a C++ type
+template <typename T>
+hid_t   native_type();
+
+// HDF5 type used for storing a C++ type in a file (always little-endian)
+template <typename T>
+hid_t   file_type();
+
+//
+// Chunk information, as returned by Dataset::get_chunks()
+//
+
+struct ChunkInfo
+{
+    dimensions  offset;             // Logical position of the chunk, in elements
+    haddr_t     address;            // Position in the file, in bytes
+    hsize_t     filtered_size;      // In bytes, as stored in the file
+    hsize_t     unfiltered_size;    // In bytes, after decoding
+    unsigned    filter_mask;        // Filters skipped for this chunk
+};
+
+//
+// Result of Dataset::diff()
+//
+
+struct DatasetDifference
+{
+    dimensions  offset;             // Block (chunk) with differences, clipped to the extent
+    dimensions  count;
+    hsize_t     num_elements;       // Number of elements that differ
+};
+
+struct DiffStatistics
+{
+    hsize_t     blocks;             // Compared
+    hsize_t     raw_equal;          // Found equal from the stored (filtered) chunks
+    hsize_t     decoded;            // Compared element by element
+    hsize_t     bytes_read;         // Stored chunk bytes read, of both datasets
+};
+
+//
+// Source of (part of) a virtual dataset, see FileAndGroupParent::create_virtual_dataset()
+//
+
+struct VirtualSource
+{
+    std::string     filename;           // Relative to the virtual dataset's file, "." for the same file
+    std::string     path;               // Of the source dataset
+    dimensions      source_offset;      // Region in the source dataset, empty for its origin
+    dimensions      offset;             // Region in the virtual dataset
+    dimensions      count;
+};
+
+//
+// Raw file holding (part of) an external dataset, see FileAndGroupParent::create_external_dataset()
+//
+
+struct ExternalFile
+{
+    std::string     filename;           // Relative to the directory of the HDF5 file
+    off_t           offset;             // In bytes, where the data starts in the file
+    hsize_t         size;               // In bytes, 0 for the rest of the data (last file only)
+};
+
+//
+// Low-level I/O of a file, for testing access patterns, see
+// FileOptions::io_monitor. Operations are the reads and writes HDF5
+// passes to its file driver, each at least one system call.
+//
+
+struct IOOperation
+{
+    bool        write;
+    haddr_t     offset;                     // In bytes
+    size_t      size;
+};
+
+struct IOMonitor
+{
+    IOMonitor();
+
+    // Clears the counters and log, not the settings
+    void        reset();
+
+    // Simulated storage, e.g. a network file system: every operation
+    // is delayed by latency seconds plus its size over bandwidth
+    double      latency;                    // In seconds
+    double      bandwidth;                  // In bytes per second, 0 for unlimited
+    bool        log;                        // Keep all operations
+
+    size_t      reads;
+    size_t      writes;
+    hsize_t     bytes_read;
+    hsize_t     bytes_written;
+    double      delay;                      // Total simulated delay, in seconds
+    std::vector<IOOperation>    operations; // When logging
+};
+
+//
+// Options for File::open() and File::create()
+//
+
+struct FileOptions
+{
+    FileOptions();
+
+    // Single-writer/multiple-reader access, i.e. reading a file while it
+    // is being appended to. Creating a file for SWMR uses the latest file
+    // format. The writer creates all objects it needs, calls
+    // File::start_swmr_write(), then only writes (appendable) datasets,
+    // using Dataset::flush() to make new data visible. Readers open the
+    // file read-only and use Dataset::refresh() or Dataset::read_new_rows().
+    bool        swmr;
+
+    // Write objects in the latest file format, which HDF5 versions before
+    // 1.10 can't read. Groups then get indexed (dense) link storage once
+    // they grow, see GroupCreationOptions, instead of the original symbol
+    // table format
+    bool        latest_format;
+
+    // Direct I/O (O_DIRECT), bypassing the page cache, for large one-pass
+    // transfers that would otherwise evict everything else from it. Uses
+    // HDF5's direct driver when available, or else our own. Transfers
+    // that aren't aligned to the file system block size (including those
+    // from/to unaligned buffers) go through an aligned bounce buffer, and
+    // objects of 64 KiB and up are placed on block boundaries. Falls back
+    // to buffered I/O on file systems without O_DIRECT support
+    bool        direct_io;
+
+    // Count (and log and/or slow down) all low-level I/O on the file,
+    // when not NULL. The monitor must outlive the file
+    IOMonitor   *io_monitor;
+
+#ifdef H5_HAVE_PARALLEL
+    // Parallel access through MPI-IO, when not MPI_COMM_NULL. Opening and
+    // closing the file, creating objects and (by default) dataset reads
+    // and writes then become collective over the processes in mpi_comm,
+    // see Dataset::set_collective()
+    MPI_Comm    mpi_comm;
+    MPI_Info    mpi_info;
+#endif
+};
+
+//
+// Options for FileAndGroupParent::create_group()
+//
+// The defaults suit large flat groups (many thousands of members): links
+// are in dense storage (a B-tree indexed heap) from the first member on,
+// instead of a list in the group's object header, and only the name index
+// is maintained. Link storage needs groups in the 1.8 format, e.g. a file
+// created with FileOptions::latest_format. In files in the default
+// (earliest) format creating such a group fails, unless
+// upgrade_file_format allows raising the file's lower format bound to 1.8.
+// That applies to all objects created afterwards, which HDF5 1.6 can't
+// read. See bench/bench_groups for how this scales with the number of
+// members.
+//
+
+struct GroupCreationOptions
+{
+    GroupCreationOptions();
+
+    // Compact (in the group's object header) up to max_compact links,
+    // dense when growing beyond that, compact again below min_dense.
+    // HDF5 defaults are 8 and 6, 0 and 0 is always dense
+    unsigned    max_compact;
+    unsigned    min_dense;
+
+    // Hints for the initial size of the group, 0 for the HDF5 defaults.
+    // Only used for compact storage, up to max_compact entries
+    unsigned    estimated_entries;
+    unsigned    estimated_name_length;
+
+    // Keep (and index) the order in which links were created, at the
+    // cost of a second index for dense storage
+    bool        track_creation_order;
+
+    // Create missing groups in the path
+    bool        create_intermediate;
+
+    // Raise the file to the 1.8 format if the link storage settings need
+    // it (not the HDF5 defaults of 8 and 6), see above
+    bool        upgrade_file_format;
+};
+
+//
+// Options for FileAndGroupParent::create_dataset()
+//
+// The defaults pick a layout automatically: compact (stored in the object
+// header, no separate raw data block) for small datasets, contiguous for
+// unfiltered fixed-size ones and chunked otherwise. Fill values are never
+// written and space is allocated late (contiguous) or per chunk, so
+// creating a huge dataset costs nothing until data gets written. Note that
+// this means elements that are never written have undefined values.
+//
+
+struct DatasetCreationOptions
+{
+    enum Layout
+    {
+        LAYOUT_AUTO,
+        LAYOUT_COMPACT,
+        LAYOUT_CONTIGUOUS,
+        LAYOUT_CHUNKED
+    };
+
+    // LZ4 and Zstandard use the registered filter IDs (32004 and 32015)
+    // and stream formats of the common HDF5 filter plugins, so other tools
+    // with those plugins can read the data. The library registers its own
+    // implementations when built with UHDF5_WITH_LZ4 or UHDF5_WITH_ZSTD
+    // (set by CMake if found), otherwise an installed plugin is needed.
+    // They decompress several times faster than deflate
+    enum Compression
+    {
+        COMPRESSION_NONE,
+        COMPRESSION_DEFLATE,        // Level 0-9, 7 by default
+        COMPRESSION_LZ4,            // Level 0 for plain LZ4 (fastest, the default), 3-12 for LZ4HC (compresses slower, decompresses as fast)
+        COMPRESSION_ZSTD            // Level 1-22, or negative for faster, 3 by default
+    };
+
+    enum FillTime
+    {
+        FILL_TIME_DEFAULT,          // HDF5 default, i.e. if a fill value is set
+        FILL_TIME_NEVER,
+        FILL_TIME_ALLOC
+    };
+
+    enum AllocTime
+    {
+        ALLOC_TIME_AUTO,            // Early for compact, late for contiguous, incremental for chunked
+        ALLOC_TIME_DEFAULT,         // HDF5 default for the layout
+        ALLOC_TIME_EARLY,
+        ALLOC_TIME_LATE,
+        ALLOC_TIME_INCREMENTAL
+    };
+
+    // Compression level picking each codec's default: 7 for deflate, plain
+    // LZ4 (the fastest) and 3 for Zstandard
+    static const int COMPRESSION_LEVEL_DEFAULT = INT_MIN;
+
+    DatasetCreationOptions();
+
+    Layout      layout;
+    dimensions  chunk_dims;             // Empty for automatic chunk dimensions
+    dimensions  max_dims;               // Empty for fixed-size, UNLIMITED for appendable axes
+    bool        shuffle;
+    Compression compression;
+    int         compression_level;      // COMPRESSION_LEVEL_DEFAULT by default
+    int         compression_threads;    // LZ4 and Zstandard: threads compressing each chunk
+    FillTime    fill_time;
+    AllocTime   alloc_time;
+    size_t      compact_size_limit;     // In bytes, for automatic layout
+    size_t      chunk_size_target;      // In bytes, for automatic chunk dimensions
+};
+
+//
+// Layout of a caller-provided memory buffer, similar to std::mdspan with
+// a strided layout: element [i0, i1, ...] is located at
+// values[offset + i0*strides[0] + i1*strides[1] + ...]
+//
+
+struct MemoryLayout
+{
+    MemoryLayout();
+    MemoryLayout(const dimensions& extents);        // Dense, row-major
+
+    // Fortran order, e.g. for passing to column-major solvers
+    static MemoryLayout column_major(const dimensions& extents);
+
+    // Field i of an array of structs with num_fields elements each
+    static MemoryLayout interleaved(const dimensions& extents, int field, int num_fields);
+
+    dimensions              extents;
+    std::vector<hsize_t>    strides;                // In elements
+    hsize_t                 offset;                 // In elements
+};
+
+//
+// Options for FileAndGroupParent::repack_dataset()
+//
+
+struct RepackOptions
+{
+    RepackOptions();
+
+    dimensions          chunk_dims;         // In destination axis order, empty for a contiguous dataset
+    bool                shuffle;
+    bool                enable_deflate_compression;
+    int                 deflate_level;
+    std::vector<int>    axis_order;         // Destination axis i is source axis axis_order[i], empty to keep the order
+    size_t              memory_budget;      // Upper bound on the buffers used, in bytes
+};
+
+//
+// Options for Pyramid::build()
+//
+
+struct PyramidOptions
+{
+    enum Method
+    {
+        METHOD_MEAN,                        // Rounded for integer types
+        METHOD_MIN,
+        METHOD_MAX,
+        METHOD_DECIMATE                     // Every factor-th element
+    };
+
+    PyramidOptions();
+
+    Method                  method;
+    int                     factor;         // Per level, along every axis
+    int                     min_size;       // No more levels once the largest axis is at most this
+    DatasetCreationOptions  dataset_options;    // For the levels
+    size_t                  memory_budget;  // Upper bound on the buffers used, in bytes
+};
+
+struct RepackStatistics
+{
+    hsize_t     bytes;                      // Amount of (uncompressed) data copied
+    int         slabs;                      // Number of read/write steps
+    double      seconds;
+    double      throughput;                 // In bytes per second
+};
+
 //
 // Type
 //
 
 class Type
 {
+public:
     enum Class
     {
         NONE=-1,
@@ -64,21 +428,33 @@ class Type
     };
 
 public:
+    Type();
     Type(hid_t type_id);
+    Type(Type&& other);
     ~Type();
 
+    Type&       operator=(Type&& other);
+
+    void        close();
+    bool        is_valid() const    { return m_type_id >= 0; }
+
     Class       get_class();
     Order       get_order();
 
     size_t      get_size();         // In bytes
     size_t      get_precision();    // In significant bits
     bool        is_signed();        // For integer types only
+    bool        is_variable_string();
 
     template <typename T>
     bool        matches();
 
     hid_t       get_id()    { return m_type_id; }
 
+protected:
+    Type(const Type&) = delete;
+    Type&       operator=(const Type&) = delete;
+
 protected:
     hid_t       m_type_id;
 };
@@ -92,25 +468,124 @@ public:
 
     virtual void close() =0;
 
+    // Number of missing paths remembered by exists()
+    static const size_t LOOKUP_CACHE_SIZE = 4096;
+
     // Returns NULL if failed
     Dataset*    open_dataset(const char *path);
+    bool        open_dataset(const char *path, Dataset& dataset);
+
+    // As open_dataset(), but fails quietly if there is no such dataset,
+    // for optional datasets
+    bool        try_open_dataset(const char *path, Dataset& dataset);
+
+    // Whether path leads to an object, checking its components one by one
+    // (so missing groups along the way are no error), without printing
+    // HDF5 errors. Missing paths are remembered by the file and the groups
+    // opened from it, until anything is created through them, so probing
+    // for the same optional objects again costs no HDF5 calls. Objects
+    // created otherwise (other File objects, SWMR writers, ...) are only
+    // seen after clear_lookup_cache()
+    bool        exists(const char *path);
+    void        clear_lookup_cache();
 
     // Returns NULL if failed
     template <typename T>
     Dataset*    create_dataset(const char *path, const dimensions& dims, bool shuffle=false,
                     const dimensions *chunk_dims=NULL, bool enable_deflate_compression=false, int deflate_level=7);
 
+    // Returns NULL if failed
+    template <typename T>
+    Dataset*    create_dataset(const char *path, const dimensions& dims, const DatasetCreationOptions& options);
+    template <typename T>
+    bool        create_dataset(const char *path, const dimensions& dims, const DatasetCreationOptions& options,
+                    Dataset& dataset);
+
+    // Dataset of strings, fixed-length (in bytes, shorter strings padded
+    // with NULs, so a string can take all of them) or variable-length when
+    // length is 0. Strings are stored as UTF-8
+    bool        create_string_dataset(const char *path, const dimensions& dims, size_t length,
+                    const DatasetCreationOptions& options, Dataset& dataset);
+
+    // Chunked dataset that can grow along the first axis, see
+    // Dataset::set_extent() and BufferedWriter. Returns NULL if failed
+    template <typename T>
+    Dataset*    create_appendable_dataset(const char *path, const dimensions& dims, const dimensions& chunk_dims,
+                    bool shuffle=false, bool enable_deflate_compression=false, int deflate_level=7);
+
     Group*      create_group(const char *path);
+    bool        create_group(const char *path, Group& group);
+    bool        create_group(const char *path, const GroupCreationOptions& options, Group& group);
+    bool        open_group(const char *path, Group& group);
+
+    // Dataset whose contents are mapped from regions of other datasets,
+    // possibly in other files (which don't need to exist yet)
+    template <typename T>
+    bool        create_virtual_dataset(const char *path, const dimensions& dims,
+                    const std::vector<VirtualSource>& sources, Dataset& dataset);
+
+    // Dataset stored in existing raw binary files (with little-endian
+    // values in row-major order), one after the other, instead of in the
+    // HDF5 file. Nothing gets copied: reads and writes go to the raw
+    // files. Such datasets are contiguous, so can't be compressed or grown
+    template <typename T>
+    bool        create_external_dataset(const char *path, const dimensions& dims,
+                    const std::vector<ExternalFile>& files, Dataset& dataset);
+
+    // Copy a dataset to a new chunk shape, compression setting and/or
+    // axis order. The data is streamed through at most options.memory_budget
+    // bytes, in slabs aligned to both the source and destination chunks,
+    // so the source can be many times larger than memory.
+    // Returns NULL if failed
+    Dataset*    repack_dataset(const char *path, Dataset *source, const RepackOptions& options,
+                    RepackStatistics *statistics=NULL);
+
+    // Copy an object (dataset, group with everything below it, ...)
+    // including its attributes, possibly between files. Chunks are copied
+    // as stored, without decompressing them. Missing groups in dst_path
+    // get created
+    static bool copy_object(FileAndGroupParent& src_parent, const char *src_path,
+                    FileAndGroupParent& dst_parent, const char *dst_path);
+
+    // Copy all members of group src_path into group dst_path, which gets
+    // created if needed. Meant for merging files, so members already in
+    // dst_path make this fail
+    static bool copy_group_members(FileAndGroupParent& src_parent, const char *src_path,
+                    FileAndGroupParent& dst_parent, const char *dst_path);
 
     hid_t       get_id()    { return m_id; }
 
 protected:
+    bool        _open_dataset(const char *path, Dataset& dataset, bool report);
+
+    const std::string&  _get_name();
+    void        _invalidate_lookups();
+    void        _set_group(hid_t group_id, Group& group);
+
+    bool        _create_virtual_dataset(const char *path, const dimensions& dims, hid_t dtype,
+                    const std::vector<VirtualSource>& sources, Dataset& dataset);
+    bool        _create_external_dataset(const char *path, const dimensions& dims, hid_t dtype,
+                    const std::vector<ExternalFile>& files, Dataset& dataset);
+
     Dataset*    _create_dataset(const char *path, const dimensions& dims, hid_t dtype,
-                    bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level);
+                    bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level,
+                    bool appendable=false);
+    Dataset*    _create_dataset(const char *path, const dimensions& dims, hid_t dtype,
+                    const DatasetCreationOptions& options);
+    bool        _create_dataset(const char *path, const dimensions& dims, hid_t dtype,
+                    const DatasetCreationOptions& options, Dataset& dataset);
+
+protected:
+    FileAndGroupParent(const FileAndGroupParent&) = delete;
+    FileAndGroupParent& operator=(const FileAndGroupParent&) = delete;
 
 protected:
     //FileAndGroupParent  *m_parent;        // XXX Rename to m_parent
     hid_t               m_id;
+    std::string         m_name;             // Absolute path, empty until needed
+
+    // Missing absolute paths, shared by a file and its groups
+    std::shared_ptr<std::set<std::string> > m_missing_paths;
 };
 
 //
@@ -124,8 +599,21 @@ public:
     ~File();
 
     bool         open(const char *fname, bool readonly=false);
+    bool         open(const char *fname, bool readonly, const FileOptions& options);
     bool         create(const char *fname, bool overwrite=true);
+    bool         create(const char *fname, bool overwrite, const FileOptions& options);
+#ifdef H5_HAVE_PARALLEL
+    bool         open(const char *fname, MPI_Comm comm, bool readonly=false, MPI_Info info=MPI_INFO_NULL);
+    bool         create(const char *fname, MPI_Comm comm, bool overwrite=true, MPI_Info info=MPI_INFO_NULL);
+#endif
     virtual void close();
+
+    // Switch a file created or opened with FileOptions::swmr to SWMR
+    // writing, after which readers can open it
+    bool         start_swmr_write();
+
+protected:
+    hid_t        _create_access_plist(const char *fname, const FileOptions& options);
 };
 
 //
@@ -135,12 +623,156 @@ public:
 class Group : public FileAndGroupParent
 {
 public:
+    Group();
     Group(hid_t group_id);
+    Group(Group&& other);
     ~Group();
 
+    Group&       operator=(Group&& other);
+
     virtual void close();
+    bool         is_valid() const   { return m_id >= 0; }
+
+protected:
+};
+
+//
+// Dataset metadata, loaded once when a Dataset is opened or created
+//
+
+struct DatasetMetadata
+{
+    enum Layout
+    {
+        LAYOUT_COMPACT,
+        LAYOUT_CONTIGUOUS,
+        LAYOUT_CHUNKED,
+        LAYOUT_VIRTUAL
+    };
+
+    // Of no dataset: no type, contiguous, empty
+    DatasetMetadata();
+
+    Type::Class                 type_class;
+    bool                        is_signed;              // For integer types only
+    size_t                      element_size;           // In bytes, as stored in the file
+    size_t                      native_element_size;    // In bytes, in memory
+    Layout                      layout;
+    dimensions                  max_dims;               // With UNLIMITED for appendable axes
+    dimensions                  chunk_dims;             // Empty unless chunked
+    std::vector<H5Z_filter_t>   filters;                // In pipeline order
+    bool                        external;               // Contiguous, in raw files
+    hsize_t                     storage_size;           // In bytes, at the time of opening
+};
+
+//
+// Strings read with Dataset::read_strings() or Attribute::read_strings().
+// All strings are stored back to back in a few large blocks, instead of
+// one allocation per string, and are freed together. Each string is
+// NUL-terminated, with its length (in bytes, excluding the NUL) stored
+// as well. Fixed-length strings lose their padding.
+//
+
+class StringTable
+{
+    friend class Dataset;
+    friend class Attribute;
+
+public:
+    StringTable();
+    StringTable(StringTable&& other);
+
+    StringTable&    operator=(StringTable&& other);
+
+    size_t      size() const                    { return m_strings.size(); }
+    const char  *get(size_t i) const            { return m_strings[i]; }
+    size_t      get_length(size_t i) const      { return m_lengths[i]; }
+    std::string get_string(size_t i) const      { return std::string(m_strings[i], m_lengths[i]); }
+
+    void        clear();
+
+protected:
+    char        *_allocate(size_t size);
+    // Of a dataset or attribute
+    bool        _read(hid_t object_id, bool is_dataset, hid_t xfer_plist);
+
+    // HDF5 variable-length memory manager, allocating from the blocks
+    static void *_vlen_allocate(size_t size, void *info);
+    static void _vlen_free(void *mem, void *info);
+
+protected:
+    StringTable(const StringTable&) = delete;
+    StringTable&    operator=(const StringTable&) = delete;
+
+protected:
+    std::vector<std::unique_ptr<char[]> >   m_blocks;
+    size_t                                  m_block_size;   // Of the last block
+    size_t                                  m_block_used;
+    std::vector<const char*>                m_strings;
+    std::vector<size_t>                     m_lengths;
+};
+
+//
+// Reusable buffer for Dataset::read() and read_hyperslab(), e.g. for
+// reading a dataset per time step. It only grows, so repeated reads of
+// the same size cost no allocation and no page faults. Memory is aligned
+// to alignment bytes, a power of 2 (64 for SIMD loads, or the page size).
+// With huge_pages it is aligned to and rounded up to 2 MiB and advised to
+// use transparent huge pages, cutting page faults and TLB misses for
+// large buffers. With first_touch_threads > 1 new memory is zeroed by
+// that many threads, each touching its own (whole) pages: on NUMA
+// machines the pages then end up local to the threads that process those
+// parts (if they are split the same way).
+//
+
+template <typename T>
+class ReadBuffer
+{
+public:
+    ReadBuffer(size_t alignment=64, bool huge_pages=false, int first_touch_threads=1);
+    ReadBuffer(ReadBuffer&& other);
+    ~ReadBuffer();
+
+    ReadBuffer& operator=(ReadBuffer&& other);
+
+    // Room for at least size elements, reallocating only if larger than
+    // before. Contents are not kept when reallocating, but are if that
+    // fails
+    bool        reserve(size_t size);
+    // Free the memory
+    void        release();
+
+    T           *data()                 { return m_data; }
+    const T     *data() const           { return m_data; }
+    T&          operator[](size_t i)    { return m_data[i]; }
+    const T&    operator[](size_t i) const  { return m_data[i]; }
+
+    // Of the last read
+    size_t      size() const            { return m_size; }
+    const dimensions&   get_dimensions() const  { return m_dims; }
+
+    size_t      capacity() const        { return m_capacity; }
+    // Number of (re)allocations so far
+    int         get_num_allocations() const     { return m_allocations; }
+
+protected:
+    friend class Dataset;
+
+    bool        _resize(const dimensions& dims);
 
 protected:
+    ReadBuffer(const ReadBuffer&) = delete;
+    ReadBuffer& operator=(const ReadBuffer&) = delete;
+
+protected:
+    T           *m_data;
+    size_t      m_size;
+    size_t      m_capacity;
+    dimensions  m_dims;
+    size_t      m_alignment;
+    bool        m_huge_pages;
+    int         m_first_touch_threads;
+    int         m_allocations;
 };
 
 //
@@ -149,32 +781,177 @@ protected:
 
 class Dataset
 {
+    friend class BufferedWriter;
+
 public:
+    Dataset();
     Dataset(hid_t dset_id, const h5::dimensions& dims);
+    Dataset(Dataset&& other);
     ~Dataset();
 
+    Dataset&    operator=(Dataset&& other);
+
+    void        close();
+    bool        is_valid() const    { return m_dataset_id >= 0; }
+
     int         get_rank() const;
     void        get_dimensions(dimensions& dims) const;
+    // With UNLIMITED for appendable axes
+    bool        get_max_dimensions(dimensions& dims) const;
+    // Grow (or shrink) within the maximum dimensions
+    bool        set_extent(const dimensions& dims);
+
+    // SWMR writers: make written data visible to readers
+    bool        flush();
+    // SWMR readers: pick up changes made by the writer, e.g. new rows
+    bool        refresh();
+
+    // SWMR readers: wait until there are more than since rows (i.e. along
+    // the first axis), polling every poll_interval seconds until timeout.
+    // Returns the current number of rows, 0 for scalars
+    hsize_t     wait_for_rows(hsize_t since, double timeout, double poll_interval=0.01);
+
+    // SWMR readers: wait for and read only the rows added after row since.
+    // Values get resized to hold them. Returns the number of rows read
+    template <typename T>
+    hsize_t     read_new_rows(std::vector<T>& values, hsize_t since, double timeout, double poll_interval=0.01);
     Type        *get_type() const;
+    bool        get_type(Type& type) const;
 
     size_t      get_size_in_bytes() const;
     size_t      get_size_in_elements() const;
     size_t      get_size_in_file_bytes() const;
 
+    // Datasets in files opened with MPI-IO default to collective reads
+    // and writes, which all processes in the communicator must make, in
+    // the same number (a process without data passes an empty count).
+    // Calls with a memory layout (which may take several transfers, see
+    // _transfer()) and for_each_chunk() add empty ones up to the most any
+    // process makes, so processes pass a layout all or none. No effect
+    // without MPI-IO
+    void        set_collective(bool collective);
+    bool        is_collective() const   { return m_collective; }
+
+    // Cached, no HDF5 calls needed
+    const DatasetMetadata&  get_metadata() const    { return m_metadata; }
+    bool        is_chunked() const      { return m_metadata.layout == DatasetMetadata::LAYOUT_CHUNKED; }
+    bool        is_compressed() const;
+
     Attribute*  get_attribute(const char *name);
+    bool        get_attribute(const char *name, Attribute& attribute);
+    // Without printing HDF5 errors
+    bool        has_attribute(const char *name);
     template <typename T>
     Attribute*  create_attribute(const char *name, const dimensions& dims);
+    template <typename T>
+    bool        create_attribute(const char *name, const dimensions& dims, Attribute& attribute);
+    // See FileAndGroupParent::create_string_dataset()
+    bool        create_string_attribute(const char *name, const dimensions& dims, size_t length,
+                    Attribute& attribute);
+
+    // All strings in the dataset. Fails for non-string datasets and for
+    // fixed-length strings that don't fit (writing)
+    bool        read_strings(StringTable& strings);
+    bool        write_strings(const std::vector<std::string>& strings);
 
     template <typename T>
     bool        read(T *values);
     template <typename T>
     bool        write(T *values);
 
+    // Into a reusable buffer, resized to the dataset (or hyperslab)
+    // dimensions, see ReadBuffer
+    template <typename T>
+    bool        read(ReadBuffer<T>& buffer);
+    template <typename T>
+    bool        read_hyperslab(ReadBuffer<T>& buffer, const dimensions& offset, const dimensions& count);
+
+    // Scatter into (gather from) a strided memory layout, e.g. to
+    // interleave several datasets or transpose. The layout extents must
+    // equal the dataset dimensions
+    template <typename T>
+    bool        read(T *values, const MemoryLayout& layout);
+    template <typename T>
+    bool        write(const T *values, const MemoryLayout& layout);
+
+    // Hyperslab access, values are densely packed with dimensions count,
+    // unless a memory layout is given (with extents equal to count)
+    template <typename T>
+    bool        read_hyperslab(T *values, const dimensions& offset, const dimensions& count,
+                    const MemoryLayout *layout=NULL);
+    template <typename T>
+    bool        write_hyperslab(const T *values, const dimensions& offset, const dimensions& count,
+                    const MemoryLayout *layout=NULL);
+
+    // Chunked datasets only. Returns false for other layouts
+    bool        get_chunk_dimensions(dimensions& dims) const;
+
+    // Allocated chunks, sorted by file address
+    bool        get_chunks(std::vector<ChunkInfo>& chunks) const;
+
+    // Visit all allocated chunks in file order, i.e. func(const ChunkInfo& chunk).
+    // This is the fastest way to scan a dataset whose chunks were not written in
+    // logical order
+    template <typename Func>
+    bool        for_each_chunk(Func func) const;
+
+    // Same, but also hand over the decoded chunk data, i.e.
+    // func(const ChunkInfo& chunk, const dimensions& count, const T *values).
+    // Count is the part of the chunk within the dataset extent, values
+    // are densely packed with those dimensions
+    template <typename T, typename Func>
+    bool        for_each_chunk(Func func);
+
+    // Compare with another dataset of the same type and dimensions, block
+    // by block, bit for bit. Blocks are the chunks, or slabs of rows when
+    // neither is chunked. When both have the same chunk dimensions and
+    // filters, stored chunks that are identical count as equal without
+    // decoding them, so only differing chunks get decompressed. Differences
+    // get the blocks with differing elements
+    bool        diff(Dataset& other, std::vector<DatasetDifference>& differences,
+                    DiffStatistics *statistics=NULL);
+
+    // Sorted 1-D datasets: bisect without reading the whole dataset, with
+    // the same meaning as std::lower_bound() etc. but returning indices.
+    // Probes read a chunk (64 KiB when not chunked, windows of at most
+    // PROBE_BLOCK_BYTES within larger chunks) at a time, and the last
+    // PROBE_CACHE_SIZE blocks are kept, so a lookup costs O(log n) block
+    // reads and nearby lookups are mostly free. Writes through this
+    // Dataset, set_extent() and refresh() drop the cache
+    template <typename T>
+    bool        lower_bound(const T& value, hsize_t& index);
+    template <typename T>
+    bool        upper_bound(const T& value, hsize_t& index);
+    template <typename T>
+    bool        equal_range(const T& value, hsize_t& first, hsize_t& last);
+
+    void        clear_probe_cache()     { m_probe_blocks.clear(); }
+
+    static const size_t PROBE_CACHE_SIZE = 16;
+    static const size_t PROBE_BLOCK_BYTES = 1024*1024;
+
     hid_t       get_id()        { return m_dataset_id; }
 
 protected:
 
+    struct _ChunkIterData
+    {
+        std::vector<ChunkInfo>  *chunks;
+        int                     rank;
+    };
+
+    struct _ProbeBlock
+    {
+        hsize_t             first;
+        hid_t               memtype;
+        std::vector<char>   values;
+    };
+
+    template <typename SizeT>
+    static int  _chunk_iter_callback(const hsize_t *offset, unsigned filter_mask, haddr_t addr, SizeT size, void *data);
+
     Attribute*  _create_attribute(const char *name, const dimensions& dims, hid_t dtype);
+    bool        _create_attribute(const char *name, const dimensions& dims, hid_t dtype, Attribute& attribute);
 
     template <typename T>
     bool        _read(T* values, hid_t memtype);
@@ -182,60 +959,502 @@ protected:
     template <typename T>
     bool        _write(const T* values, hid_t memtype);
 
+    bool        _transfer(bool writing, void *values, hid_t memtype, const dimensions& offset,
+                    const dimensions& count, const MemoryLayout *layout);
+
+    bool        _check_transfer(const dimensions& offset, const dimensions& count, const MemoryLayout *layout);
+    bool        _transfer_none(bool writing, hid_t memtype);
+    // Number of transfers to make, padding num_transfers with empty ones
+    // when collective: one, or if the number may differ between processes,
+    // the most any process makes (an MPI_Allreduce() all must call)
+    long long   _num_transfers(long long num_transfers, bool may_differ) const;
+
+    void        _load_metadata();
+    bool        _check_numeric() const;
+    // Also that values of type T match: integers of the same size and
+    // signedness (conversions would silently wrap or truncate), or any
+    // floating-point type
+    template <typename T>
+    bool        _check_numeric() const;
+
+    template <typename T>
+    bool        _probe(hsize_t index, T& value);
+    template <typename T>
+    bool        _bisect(const T& value, bool upper, hsize_t first, hsize_t& index);
+
+protected:
+    Dataset(const Dataset&) = delete;
+    Dataset&    operator=(const Dataset&) = delete;
+
 protected:
     hid_t           m_dataset_id;
     h5::dimensions  m_dimensions;
+    DatasetMetadata m_metadata;
+    hid_t           m_transfer_plist;
+    bool            m_mpio;
+    bool            m_collective;
+#ifdef H5_HAVE_PARALLEL
+    MPI_Comm        m_comm;                     // Of the file, duplicated once
+#endif
+
+    std::list<_ProbeBlock>  m_probe_blocks;     // Most recently used first
 };
 
 //
-// Attribute
+// BufferedWriter
+//
+// Sequential writer of rows (i.e. along the first axis) that gathers small
+// writes in memory and writes exactly once per completed chunk. This avoids
+// a read-modify-write (and recompression) of a chunk for every small write.
+// Appendable datasets are extended as needed. Any partial chunk at the end
+// is written by flush(), which also happens on close and destruction.
 //
 
-class Attribute
+class BufferedWriter
 {
 public:
-    Attribute(Dataset *dataset, hid_t attr_id);
-    ~Attribute();
+    // Starts writing at start_row, or at the end of an appendable dataset
+    // when start_row is negative
+    BufferedWriter(Dataset *dataset, long long start_row=-1);
+    ~BufferedWriter();
 
-    bool        get_dimensions(dimensions& dims);
-    Type        *get_type();
-
-    template <typename T>
-    bool        read(T *values);
     template <typename T>
-    bool        write(T *values);
+    bool        write(const T *values, hsize_t rows);
 
-    hid_t       get_id()        { return m_attribute_id; }
+    bool        flush();
+    // Flushes, false if the buffered rows couldn't be written (they are
+    // dropped either way)
+    bool        close();
 
-protected:
+    // Next row to be written
+    hsize_t     get_row() const     { return m_start_row + m_buffered_rows; }
 
-    template <typename T>
-    bool        _read(T* values, hid_t memtype);
+protected:
 
-    template <typename T>
-    bool        _write(const T* values, hid_t memtype);
+    bool        _write(const void *values, hsize_t rows, hid_t memtype);
+    bool        _write_rows(const void *values, hsize_t start_row, hsize_t rows);
 
 protected:
-    Dataset     *m_dataset;
-    hid_t       m_attribute_id;
+    Dataset             *m_dataset;
+    bool                m_appendable;
+    hid_t               m_memtype;
+    size_t              m_row_size;         // In bytes, 0 until the first write
+    hsize_t             m_chunk_rows;
+    hsize_t             m_start_row;        // Of the buffer
+    hsize_t             m_buffered_rows;
+    std::vector<char>   m_buffer;
 };
 
-// -----------------------------------------------------------------
-// Implementation
-// -----------------------------------------------------------------
-
 //
-// Type
+// ShardedWriter
+//
+// Writes one logical dataset from many independent producers, without
+// funneling all data through one File (and without MPI). The dataset is
+// split along the first axis into shards, each written to its own file
+// by create_shard(). A master file holds a virtual dataset mapping all
+// shards into one array, which readers open with a plain open_dataset().
+//
+// The shard layout only depends on the constructor arguments, so each
+// producer process can construct its own ShardedWriter and write its
+// shard without communicating. Note that producer threads in a single
+// process get serialized by the HDF5 library lock, so use processes to
+// write at aggregate disk bandwidth.
 //
 
-Type::Type(hid_t type_id)
+class ShardedWriter
 {
-    m_type_id = type_id;
-}
+public:
+    // Shard files are named after the master file, e.g. out.h5 gives
+    // out.shard0.h5, out.shard1.h5, ... in the same directory. Dimensions
+    // need a rank of at least 1, otherwise there are no shards
+    ShardedWriter(const char *master_fname, const char *path, const dimensions& dims, int num_shards,
+        const DatasetCreationOptions& shard_options=DatasetCreationOptions());
+
+    int         get_num_shards() const  { return m_num_shards; }
+    bool        get_shard(int index, std::string& fname, dimensions& offset, dimensions& count) const;
+
+    // Create the master file, once
+    template <typename T>
+    bool        create_master(bool overwrite=true);
+
+    // Create shard index, i.e. its file and a dataset with the shard's
+    // dimensions. The shard's data is then written through dataset
+    template <typename T>
+    bool        create_shard(int index, File& file, Dataset& dataset);
+
+protected:
+    std::string _shard_filename(int index, bool with_directory) const;
+
+protected:
+    std::string             m_master_fname;
+    std::string             m_path;
+    dimensions              m_dims;
+    int                     m_num_shards;
+    int                     m_rows_per_shard;
+    DatasetCreationOptions  m_shard_options;
+};
+
+//
+// RaggedArray
+//
+// Many small 1-D arrays ("items") of varying size, e.g. per-event data,
+// packed into a group holding a single chunked "values" dataset and an
+// "offsets" dataset. Item i is values[offsets[i]] up to values[offsets[i+1]]
+// (as in the CSR sparse matrix format), so the offsets have one entry more
+// than there are items. Compared to a dataset per item this saves a lot of
+// metadata, compresses better and opens much faster. The offsets are read
+// when opening, so finding an item doesn't need any I/O.
+//
+
+template <typename T>
+class RaggedArray
+{
+public:
+    RaggedArray();
+    ~RaggedArray();
+
+    bool        create(FileAndGroupParent& parent, const char *path, hsize_t chunk_size=64*1024,
+                    bool shuffle=true, bool enable_deflate_compression=true, int deflate_level=7);
+    // Items can be appended to an opened array as well
+    bool        open(FileAndGroupParent& parent, const char *path);
+    bool        close();
+
+    hsize_t     get_num_items() const       { return m_offsets.empty() ? 0 : m_offsets.size() - 1; }
+    hsize_t     get_item_size(hsize_t item) const  { return m_offsets[item+1] - m_offsets[item]; }
+
+    // Appended items are buffered until a chunk of values is full, see
+    // BufferedWriter. Reads flush them first
+    bool        append(const T *values, hsize_t size);
+    bool        flush();
+
+    // Values get resized to hold the item
+    bool        read(hsize_t item, std::vector<T>& values);
+    // Items first up to first+count, with a single read. Item first+i is
+    // values[offsets[i]] up to values[offsets[i+1]]. Fails for values past
+    // INT_MAX, as hyperslabs (see dimensions) are int
+    bool        read_range(hsize_t first, hsize_t count, std::vector<T>& values,
+                    std::vector<hsize_t>& offsets);
+
+protected:
+    RaggedArray(const RaggedArray&) = delete;
+    RaggedArray& operator=(const RaggedArray&) = delete;
+
+protected:
+    Group                   m_group;
+    Dataset                 m_values;
+    Dataset                 m_offsets_dataset;
+    BufferedWriter          *m_values_writer;
+    BufferedWriter          *m_offsets_writer;
+    std::vector<uint64_t>   m_offsets;
+};
+
+//
+// DedupWriter
+//
+// Writes datasets as virtual datasets over a shared pool of unique
+// chunks, so chunks repeated within or across datasets (constant regions,
+// unchanged parts of reprocessed outputs, ...) are stored once. Each
+// chunk written is hashed (128 bits) to find earlier copies in the pool,
+// which get read back and compared before the chunk is mapped to one, so
+// hash collisions can't mix up data. New chunks are appended. The pool is a
+// chunked (possibly compressed) dataset with chunk_dims[0] rows per
+// unique chunk, in the same file. Datasets written are read as any other
+// with open_dataset(). Each chunk is a mapping of the virtual dataset,
+// which slows down opening datasets of very many chunks. The hash index
+// only lives as long as the writer.
+//
+
+template <typename T>
+class DedupWriter
+{
+public:
+    DedupWriter();
+
+    bool        create(FileAndGroupParent& parent, const char *pool_path, const dimensions& chunk_dims,
+                    const DatasetCreationOptions& options=DatasetCreationOptions());
+    void        close();
+
+    // Values are densely packed with dimensions dims, of the same rank as
+    // the chunk dimensions
+    bool        write(const char *path, const T *values, const dimensions& dims, Dataset& dataset);
+
+    hsize_t     get_num_chunks() const          { return m_num_chunks; }
+    hsize_t     get_num_unique_chunks() const   { return m_num_unique_chunks; }
+
+protected:
+    DedupWriter(const DedupWriter&) = delete;
+    DedupWriter& operator=(const DedupWriter&) = delete;
+
+protected:
+    FileAndGroupParent                          *m_parent;
+    std::string                                 m_pool_path;        // Absolute, for the mappings
+    Dataset                                     m_pool;
+    dimensions                                  m_chunk_dims;
+    std::multimap<std::pair<uint64_t, uint64_t>, hsize_t>   m_index;    // Hash to pool slots
+    hsize_t                                     m_num_chunks;
+    hsize_t                                     m_num_unique_chunks;
+};
+
+//
+// FilePool
+//
+// Keeps recently used files open, for jobs that go over many files and
+// come back to them. Reopening a file from the pool then costs no
+// superblock and metadata parsing, and the file's metadata cache stays
+// warm. Files are keyed by file name (as given) and access mode. At most
+// max_open files are kept open: opening another one closes the least
+// recently used file that isn't in use, i.e. with no File or Dataset
+// handles from the pool held outside it. When all are in use the pool
+// temporarily grows beyond max_open. Not thread-safe.
+//
+
+class FilePool
+{
+public:
+    FilePool(size_t max_open=64, const FileOptions& options=FileOptions());
+    ~FilePool();
+
+    // Returns NULL if failed
+    std::shared_ptr<File>       open(const char *fname, bool readonly=true);
+
+    // Datasets are cached per file, so repeated opens of the same path
+    // return the same handle. Returns NULL if failed
+    std::shared_ptr<Dataset>    open_dataset(const char *fname, const char *path, bool readonly=true);
+
+    // Close all files (and datasets) not in use
+    void        clear();
+
+    size_t      get_num_open() const    { return m_entries.size(); }
+    size_t      get_max_open() const    { return m_max_open; }
+
+protected:
+    struct Entry
+    {
+        std::string                                     fname;
+        bool                                            readonly;
+        std::shared_ptr<File>                           file;
+        std::map<std::string, std::shared_ptr<Dataset> > datasets;
+
+        bool    in_use() const;
+    };
+
+    typedef std::pair<std::string, bool>    Key;
+
+    Entry       *_open(const char *fname, bool readonly);
+    void        _evict(size_t max_open);
+
+protected:
+    FilePool(const FilePool&) = delete;
+    FilePool&   operator=(const FilePool&) = delete;
+
+protected:
+    size_t                                      m_max_open;
+    FileOptions                                 m_options;
+    std::list<Entry>                            m_entries;      // Most recently used first
+    std::map<Key, std::list<Entry>::iterator>   m_index;
+};
+
+//
+// DirectReader
+//
+// Reads contiguous or unfiltered chunked datasets with plain pread() calls
+// on its own file descriptor, instead of through the HDF5 library, whose
+// global lock serializes all threads. The file offsets of the data (of
+// each chunk) are looked up once when opening. After that read_hyperslab()
+// makes no HDF5 calls and can be used from any number of threads at the
+// same time. Only for numeric datasets stored in the native type (so no
+// conversion is needed), in files without a user block. Unallocated chunks
+// read as zeros, whatever the fill value. The file must not be written
+// while reading.
+//
+
+class DirectReader
+{
+public:
+    DirectReader();
+    ~DirectReader();
+
+    bool        open(Dataset& dataset);
+    void        close();
+    bool        is_valid() const    { return m_fd >= 0; }
+
+    // Values are densely packed with dimensions count. Thread-safe
+    template <typename T>
+    bool        read_hyperslab(T *values, const dimensions& offset, const dimensions& count) const;
+
+protected:
+    bool        _read_hyperslab(char *values, const dimensions& offset, const dimensions& count) const;
+    bool        _read_block(char *values, const hsize_t *values_dims, const hsize_t *values_start,
+                    haddr_t address, const hsize_t *block_dims, const hsize_t *start, const hsize_t *count) const;
+
+protected:
+    DirectReader(const DirectReader&) = delete;
+    DirectReader&   operator=(const DirectReader&) = delete;
+
+protected:
+    int                     m_fd;
+    dimensions              m_dims;
+    dimensions              m_chunk_dims;       // Empty if contiguous
+    dimensions              m_chunk_grid;       // Number of chunks along each axis
+    Type::Class             m_type_class;
+    bool                    m_signed;
+    size_t                  m_element_size;
+    haddr_t                 m_address;          // Contiguous
+    std::vector<haddr_t>    m_chunk_addresses;  // Row-major over the chunk grid, HADDR_UNDEF if unallocated
+};
+
+//
+// Attribute
+//
+
+class Attribute
+{
+public:
+    Attribute();
+    // Owns attr_id. The dataset isn't kept, so the attribute stays usable
+    // after the dataset is moved or closed
+    Attribute(Dataset *dataset, hid_t attr_id);
+    Attribute(Attribute&& other);
+    ~Attribute();
+
+    Attribute&  operator=(Attribute&& other);
+
+    void        close();
+    bool        is_valid() const    { return m_attribute_id >= 0; }
+
+    bool        get_dimensions(dimensions& dims);
+    Type        *get_type();
+    bool        get_type(Type& type);
+
+    template <typename T>
+    bool        read(T *values);
+    template <typename T>
+    bool        write(T *values);
+
+    // See Dataset::read_strings()
+    bool        read_strings(StringTable& strings);
+    bool        write_strings(const std::vector<std::string>& strings);
+
+    hid_t       get_id()        { return m_attribute_id; }
+
+protected:
+
+    template <typename T>
+    bool        _read(T* values, hid_t memtype);
+
+    template <typename T>
+    bool        _write(const T* values, hid_t memtype);
+
+protected:
+    Attribute(const Attribute&) = delete;
+    Attribute&  operator=(const Attribute&) = delete;
+
+protected:
+    hid_t       m_attribute_id;
+};
+
+//
+// Pyramid
+//
+// Downsampled copies ("levels") of a 2-D or 3-D dataset, for overviews
+// of datasets much larger than what gets displayed. Level k is stored
+// next to the dataset as path_level<k>, factor^k times smaller along
+// every axis (rounded up), and the dataset itself is level 0. Each level
+// is computed from the previous one in slabs of whole rows, so building
+// reads the dataset once and needs memory_budget bytes, not the dataset
+// size. Means of partial blocks at the far edges are means of means.
+//
+
+class Pyramid
+{
+public:
+    Pyramid();
+
+    // Fails if the dataset already has levels
+    template <typename T>
+    static bool build(FileAndGroupParent& parent, const char *path,
+                    const PyramidOptions& options=PyramidOptions());
+
+    bool        open(FileAndGroupParent& parent, const char *path);
+    void        close();
+
+    // Including level 0
+    int         get_num_levels() const      { return m_levels.size(); }
+    int         get_factor() const          { return m_factor; }
+    void        get_dimensions(int level, dimensions& dims) const   { m_levels[level].get_dimensions(dims); }
+    Dataset&    get_level(int level)        { return m_levels[level]; }
+
+    // Coarsest level at which a region of count elements (at level 0)
+    // still spans at least resolution elements along every axis
+    int         select_level(const dimensions& count, const dimensions& resolution) const;
+
+    // Read the region offset/count (at level 0) from the level picked by
+    // select_level(), e.g. with resolution the size of a viewport. Values
+    // get resized to hold dims elements, the region at that level
+    // (rounded outwards). Returns the level, or -1 if failed
+    template <typename T>
+    int         read_region(const dimensions& offset, const dimensions& count, const dimensions& resolution,
+                    std::vector<T>& values, dimensions& dims);
+
+protected:
+    Pyramid(const Pyramid&) = delete;
+    Pyramid&    operator=(const Pyramid&) = delete;
+
+protected:
+    std::vector<Dataset>    m_levels;
+    int                     m_factor;
+};
+
+// -----------------------------------------------------------------
+// Implementation
+// -----------------------------------------------------------------
+
+//
+// Type
+//
+
+Type::Type()
+{
+    m_type_id = -1;
+}
+
+Type::Type(hid_t type_id)
+{
+    m_type_id = type_id;
+}
+
+Type::Type(Type&& other)
+{
+    m_type_id = other.m_type_id;
+    other.m_type_id = -1;
+}
 
 Type::~Type()
 {
+    close();
+}
+
+Type&
+Type::operator=(Type&& other)
+{
+    if (this != &other)
+    {
+        close();
+        m_type_id = other.m_type_id;
+        other.m_type_id = -1;
+    }
+
+    return *this;
+}
+
+void
+Type::close()
+{
+    if (m_type_id < 0)
+        return;
+
     H5Tclose(m_type_id);
+    m_type_id = -1;
 }
 
 Type::Class
@@ -259,6 +1478,12 @@ Type::get_class()
     }
 }
 
+bool
+Type::is_variable_string()
+{
+    return H5Tis_variable_str(m_type_id) > 0;
+}
+
 Type::Order
 Type::get_order()
 {
@@ -317,637 +1542,5613 @@ template<> bool Type::matches<uint32_t>()   { return get_class() == INTEGER && g
 template<> bool Type::matches<uint64_t>()   { return get_class() == INTEGER && get_size() == 8 && !is_signed(); }
 
 //
-// FileAndGroupParent
+// Native and file types
 //
 
-FileAndGroupParent::FileAndGroupParent()
+template<> hid_t native_type<float>()       { return H5T_NATIVE_FLOAT; }
+template<> hid_t native_type<double>()      { return H5T_NATIVE_DOUBLE; }
+
+template<> hid_t native_type<int8_t>()      { return H5T_NATIVE_INT8; }
+template<> hid_t native_type<int16_t>()     { return H5T_NATIVE_INT16; }
+template<> hid_t native_type<int32_t>()     { return H5T_NATIVE_INT32; }
+template<> hid_t native_type<int64_t>()     { return H5T_NATIVE_INT64; }
+
+template<> hid_t native_type<uint8_t>()     { return H5T_NATIVE_UINT8; }
+template<> hid_t native_type<uint16_t>()    { return H5T_NATIVE_UINT16; }
+template<> hid_t native_type<uint32_t>()    { return H5T_NATIVE_UINT32; }
+template<> hid_t native_type<uint64_t>()    { return H5T_NATIVE_UINT64; }
+
+template<> hid_t file_type<float>()         { return H5T_IEEE_F32LE; }
+template<> hid_t file_type<double>()        { return H5T_IEEE_F64LE; }
+
+template<> hid_t file_type<int8_t>()        { return H5T_STD_I8LE; }
+template<> hid_t file_type<int16_t>()       { return H5T_STD_I16LE; }
+template<> hid_t file_type<int32_t>()       { return H5T_STD_I32LE; }
+template<> hid_t file_type<int64_t>()       { return H5T_STD_I64LE; }
+
+template<> hid_t file_type<uint8_t>()       { return H5T_STD_U8LE; }
+template<> hid_t file_type<uint16_t>()      { return H5T_STD_U16LE; }
+template<> hid_t file_type<uint32_t>()      { return H5T_STD_U32LE; }
+template<> hid_t file_type<uint64_t>()      { return H5T_STD_U64LE; }
+
+//
+// LZ4 and Zstandard filters
+//
+
+const H5Z_filter_t  _FILTER_LZ4 = 32004;
+const H5Z_filter_t  _FILTER_ZSTD = 32015;
+
+// func(i) for i in [0, n), on up to num_threads threads
+template <typename Func>
+static void
+_parallel_for(size_t n, int num_threads, Func func)
 {
-    //m_parent = NULL;
-    m_id = -1;      // XXX type is signed?
+    if (num_threads <= 1 || n <= 1)
+    {
+        for (size_t i = 0; i < n; i++)
+            func(i);
+        return;
+    }
+
+    std::vector<std::thread>    threads;
+    const size_t                count = std::min((size_t)num_threads, n);
+
+    for (size_t t = 0; t < count; t++)
+        threads.push_back(std::thread([&func, t, n, count]()
+        {
+            for (size_t i = t; i < n; i += count)
+                func(i);
+        }));
+
+    for (size_t t = 0; t < count; t++)
+        threads[t].join();
 }
 
-FileAndGroupParent::FileAndGroupParent(hid_t id)
+#ifdef UHDF5_WITH_LZ4
+
+static void
+_put_be32(char *p, uint32_t v)
 {
-    //m_parent = parent;
-    m_id = id;
+    for (int i = 3; i >= 0; i--, v >>= 8)
+        p[i] = (char)(v & 0xff);
 }
 
-FileAndGroupParent::~FileAndGroupParent()
+static uint32_t
+_get_be32(const char *p)
 {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++)
+        v = (v << 8) | (unsigned char)p[i];
+    return v;
 }
 
-Dataset*
-FileAndGroupParent::open_dataset(const char *path)
+// Stream format of the HDF5 LZ4 plugin: the original size (8 bytes) and
+// block size (4 bytes), then per block its compressed size (4 bytes) and
+// data, all big-endian. Blocks that don't compress are stored as is.
+// Cd_values are the block size (0 for whole chunks), and for this
+// implementation only the level and number of threads.
+static size_t
+_lz4_filter(unsigned flags, size_t cd_nelmts, const unsigned cd_values[], size_t nbytes,
+    size_t *buf_size, void **buf)
 {
-    hid_t   dataset_id;
-
-    dataset_id = H5Dopen2(m_id, path, H5P_DEFAULT);
+    const char  *src = static_cast<const char*>(*buf);
+    const int   num_threads = cd_nelmts > 2 ? (int)cd_values[2] : 1;
+    char        *out;
+    size_t      out_size;
 
-    if (dataset_id < 0)
+    if (flags & H5Z_FLAG_REVERSE)
     {
-        fprintf(stderr, "Failed to open dataset '%s'!\n", path);
-        return NULL;
+        if (nbytes < 12)
+            return 0;
+
+        const uint64_t  size = ((uint64_t)_get_be32(src) << 32) | _get_be32(src + 4);
+        const uint64_t  block_size = std::min<uint64_t>(_get_be32(src + 8), size);
+
+        // Chunks are never empty, and nothing would fill the output
+        if (block_size == 0)
+        {
+            fprintf(stderr, "Corrupt LZ4 chunk!\n");
+            return 0;
+        }
+
+        const size_t    num_blocks = (size + block_size - 1) / block_size;
+
+        // Find the blocks first, to decode them in parallel
+        std::vector<size_t> positions(num_blocks);
+        size_t              position = 12;
+
+        for (size_t b = 0; b < num_blocks; b++)
+        {
+            if (position + 4 > nbytes)
+                return 0;
+            positions[b] = position;
+            position += 4 + _get_be32(src + position);
+        }
+
+        if (position > nbytes || (out = static_cast<char*>(malloc(size))) == NULL)
+            return 0;
+
+        std::atomic<bool> ok(true);
+
+        _parallel_for(num_blocks, num_threads, [&](size_t b)
+        {
+            const uint32_t  compressed = _get_be32(src + positions[b]);
+            const uint64_t  bytes = std::min<uint64_t>(block_size, size - b * block_size);
+            const char      *block = src + positions[b] + 4;
+
+            if (compressed == bytes)
+                memcpy(out + b * block_size, block, bytes);
+            else if (LZ4_decompress_safe(block, out + b * block_size, compressed, bytes) != (int)bytes)
+                ok = false;
+        });
+
+        if (!ok)
+        {
+            fprintf(stderr, "Corrupt LZ4 chunk!\n");
+            free(out);
+            return 0;
+        }
+
+        out_size = size;
+    }
+    else
+    {
+        if (nbytes == 0)
+            return 0;
+
+        const uint64_t  block_size = std::min<uint64_t>(cd_nelmts > 0 && cd_values[0] > 0 ? cd_values[0] : 1U << 30, nbytes);
+        const size_t    num_blocks = (nbytes + block_size - 1) / block_size;
+        const int       level = cd_nelmts > 1 ? (int)cd_values[1] : 0;
+        const size_t    bound = LZ4_compressBound(block_size);
+
+        // Each block into its own slot, then packed
+        std::vector<char>   slots(num_blocks * bound);
+        std::vector<int>    sizes(num_blocks);
+
+        _parallel_for(num_blocks, num_threads, [&](size_t b)
+        {
+            const int bytes = std::min<uint64_t>(block_size, nbytes - b * block_size);
+
+            if (level >= LZ4HC_CLEVEL_MIN)
+                sizes[b] = LZ4_compress_HC(src + b * block_size, &slots[b * bound], bytes, bound, level);
+            else
+                sizes[b] = LZ4_compress_default(src + b * block_size, &slots[b * bound], bytes, bound);
+
+            if (sizes[b] <= 0 || sizes[b] >= bytes)
+                sizes[b] = bytes;
+        });
+
+        out_size = 12 + 4 * num_blocks;
+        for (size_t b = 0; b < num_blocks; b++)
+            out_size += sizes[b];
+
+        if ((out = static_cast<char*>(malloc(out_size))) == NULL)
+            return 0;
+
+        _put_be32(out, (uint32_t)((uint64_t)nbytes >> 32));
+        _put_be32(out + 4, (uint32_t)nbytes);
+        _put_be32(out + 8, block_size);
+
+        char *p = out + 12;
+        for (size_t b = 0; b < num_blocks; b++)
+        {
+            const int bytes = std::min<uint64_t>(block_size, nbytes - b * block_size);
+
+            _put_be32(p, sizes[b]);
+            memcpy(p + 4, sizes[b] == bytes ? src + b * block_size : &slots[b * bound], sizes[b]);
+            p += 4 + sizes[b];
+        }
     }
 
-    // Get dimensions
+    free(*buf);
+    *buf = out;
+    *buf_size = out_size;
 
-    hid_t           dataspace_id;
-    int             ndims;
-    h5::dimensions  dims;
+    return out_size;
+}
 
-    dataspace_id = H5Dget_space(dataset_id);
-    if (dataspace_id < 0)
+#endif
+
+#ifdef UHDF5_WITH_ZSTD
+
+// A single Zstandard frame, as the HDF5 Zstandard plugin. Cd_values are
+// the level, and for this implementation only the number of threads,
+// which needs a multithreaded libzstd (otherwise one thread is used)
+static size_t
+_zstd_filter(unsigned flags, size_t cd_nelmts, const unsigned cd_values[], size_t nbytes,
+    size_t *buf_size, void **buf)
+{
+    char    *out;
+    size_t  out_size;
+
+    if (flags & H5Z_FLAG_REVERSE)
     {
-        fprintf(stderr, "Could not get dataspace!\n");
-        return NULL;
-    }
+        const unsigned long long size = ZSTD_getFrameContentSize(*buf, nbytes);
 
-    ndims = H5Sget_simple_extent_ndims(dataspace_id);
-    if (ndims < 0)
+        if (size == ZSTD_CONTENTSIZE_ERROR || size == ZSTD_CONTENTSIZE_UNKNOWN ||
+            (out = static_cast<char*>(malloc(size))) == NULL)
+            return 0;
+
+        out_size = ZSTD_decompress(out, size, *buf, nbytes);
+    }
+    else
     {
-        fprintf(stderr, "Could not get dataset dimensions!\n");
-        return NULL;
+        const int   level = cd_nelmts > 0 ? (int)cd_values[0] : ZSTD_CLEVEL_DEFAULT;
+        const int   num_threads = cd_nelmts > 1 ? (int)cd_values[1] : 1;
+        const size_t bound = ZSTD_compressBound(nbytes);
+
+        if ((out = static_cast<char*>(malloc(bound))) == NULL)
+            return 0;
+
+        ZSTD_CCtx   *context = ZSTD_createCCtx();
+
+        ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, level);
+        if (num_threads > 1)
+            ZSTD_CCtx_setParameter(context, ZSTD_c_nbWorkers, num_threads);
+
+        out_size = ZSTD_compress2(context, out, bound, *buf, nbytes);
+
+        ZSTD_freeCCtx(context);
     }
-    
-    hsize_t d[ndims];
-    H5Sget_simple_extent_dims(dataspace_id, d, NULL);
 
-    H5Sclose(dataspace_id);
-    
-    for (int i = 0; i < ndims; i++)
-        dims.push_back(d[i]);
+    if (ZSTD_isError(out_size))
+    {
+        fprintf(stderr, "Zstandard error: %s!\n", ZSTD_getErrorName(out_size));
+        free(out);
+        return 0;
+    }
 
-    // Done
+    free(*buf);
+    *buf = out;
+    *buf_size = out_size;
 
-    return new Dataset(dataset_id, dims);
+    return out_size;
 }
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<float>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
-{
-    return _create_dataset(path, dims, H5T_IEEE_F32LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
-}
+#endif
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<double>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+// Registers the built-in filters once. They replace any plugins for the
+// same IDs
+static void
+_register_fast_filters()
 {
-    return _create_dataset(path, dims, H5T_IEEE_F64LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
-}
+    static bool registered = false;
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<int8_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+    if (registered)
+        return;
+
+    registered = true;
+
+#ifdef UHDF5_WITH_LZ4
+    H5Z_class2_t lz4 = { H5Z_CLASS_T_VERS, _FILTER_LZ4, 1, 1, "lz4 (uhdf5)", NULL, NULL, _lz4_filter };
+    H5Zregister(&lz4);
+#endif
+
+#ifdef UHDF5_WITH_ZSTD
+    H5Z_class2_t zstd = { H5Z_CLASS_T_VERS, _FILTER_ZSTD, 1, 1, "zstd (uhdf5)", NULL, NULL, _zstd_filter };
+    H5Zregister(&zstd);
+#endif
+}
+
+// Level to use, for the codec of options.compression
+static int
+_compression_level(const DatasetCreationOptions& options)
 {
-    return _create_dataset(path, dims, H5T_STD_I8LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
+    if (options.compression_level != DatasetCreationOptions::COMPRESSION_LEVEL_DEFAULT)
+        return options.compression_level;
+
+    switch (options.compression)
+    {
+    case DatasetCreationOptions::COMPRESSION_DEFLATE:
+        return 7;
+    case DatasetCreationOptions::COMPRESSION_ZSTD:
+        return 3;
+    default:
+        return 0;
+    }
 }
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<int16_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+// Adds LZ4 or Zstandard to a chunked dataset creation plist
+static bool
+_set_fast_filter(hid_t plist_id, hid_t dtype, const DatasetCreationOptions& options)
 {
-    return _create_dataset(path, dims, H5T_STD_I16LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
+    const bool      lz4 = options.compression == DatasetCreationOptions::COMPRESSION_LZ4;
+    const H5Z_filter_t  filter = lz4 ? _FILTER_LZ4 : _FILTER_ZSTD;
+
+    _register_fast_filters();
+
+    if (H5Zfilter_avail(filter) <= 0)
+    {
+        fprintf(stderr, "%s filter not available, build with %s or install its HDF5 plugin!\n",
+            lz4 ? "LZ4" : "Zstandard", lz4 ? "UHDF5_WITH_LZ4" : "UHDF5_WITH_ZSTD");
+        return false;
+    }
+
+    const unsigned  threads = std::max(options.compression_threads, 1);
+
+    if (!lz4)
+    {
+        const unsigned cd_values[2] = { (unsigned)_compression_level(options), threads };
+        return H5Pset_filter(plist_id, filter, H5Z_FLAG_MANDATORY, 2, cd_values) >= 0;
+    }
+
+    // With more threads, split chunks into a block per thread (of at
+    // least 64 KiB, as LZ4 compresses small blocks worse)
+    unsigned    block_size = 0;
+
+    if (threads > 1)
+    {
+        const int   N = H5Pget_chunk(plist_id, 0, NULL);
+        hsize_t     c[N > 0 ? N : 1];
+        hsize_t     chunk_bytes = H5Tget_size(dtype);
+
+        H5Pget_chunk(plist_id, N, c);
+        for (int i = 0; i < N; i++)
+            chunk_bytes *= c[i];
+
+        block_size = std::max<hsize_t>((chunk_bytes + threads - 1) / threads, 64*1024);
+    }
+
+    const unsigned cd_values[3] = { block_size, (unsigned)std::max(_compression_level(options), 0), threads };
+    return H5Pset_filter(plist_id, filter, H5Z_FLAG_MANDATORY, 3, cd_values) >= 0;
 }
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<int32_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+//
+// FileAndGroupParent
+//
+
+// Relative names of external files are relative to the HDF5 file, not
+// the current directory (as VDS source files). Only for external datasets,
+// as HDF5 refuses to open a dataset that is already open with another
+// prefix
+static hid_t
+_dataset_access_plist()
 {
-    return _create_dataset(path, dims, H5T_STD_I32LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
+    static hid_t plist_id = -1;
+
+    if (plist_id >= 0 && H5Iis_valid(plist_id) > 0)
+        return plist_id;
+
+    plist_id = H5Pcreate(H5P_DATASET_ACCESS);
+    H5Pset_efile_prefix(plist_id, "${ORIGIN}");
+
+    return plist_id;
 }
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<int64_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+// Name of an external file as HDF5 finds it with _dataset_access_plist(),
+// i.e. relative to the directory of the HDF5 file
+static std::string
+_external_file_path(hid_t id, const std::string& filename)
 {
-    return _create_dataset(path, dims, H5T_STD_I64LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
+    const ssize_t length = H5Fget_name(id, NULL, 0);
+
+    if (filename.empty() || filename[0] == '/' || length <= 0)
+        return filename;
+
+    std::vector<char> name(length + 1);
+    H5Fget_name(id, &name[0], name.size());
+
+    const char *slash = strrchr(&name[0], '/');
+
+    return slash == NULL ? filename : std::string((const char *)&name[0], slash + 1) + filename;
 }
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<uint8_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+// Turns off printing the HDF5 error stack, where failing is expected,
+// while in scope
+class _ErrorSilencer
 {
-    return _create_dataset(path, dims, H5T_STD_U8LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
+public:
+    _ErrorSilencer()
+    {
+        H5Eget_auto2(H5E_DEFAULT, &m_func, &m_data);
+        H5Eset_auto2(H5E_DEFAULT, NULL, NULL);
+    }
+
+    ~_ErrorSilencer()
+    {
+        H5Eset_auto2(H5E_DEFAULT, m_func, m_data);
+    }
+
+protected:
+    H5E_auto2_t m_func;
+    void        *m_data;
+};
+
+FileAndGroupParent::FileAndGroupParent()
+{
+    //m_parent = NULL;
+    m_id = -1;      // XXX type is signed?
 }
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<uint16_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+FileAndGroupParent::FileAndGroupParent(hid_t id)
 {
-    return _create_dataset(path, dims, H5T_STD_U16LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
+    //m_parent = parent;
+    m_id = id;
 }
 
-template<>
-Dataset*
-FileAndGroupParent::create_dataset<uint32_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+FileAndGroupParent::~FileAndGroupParent()
 {
-    return _create_dataset(path, dims, H5T_STD_U32LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-template<>
 Dataset*
-FileAndGroupParent::create_dataset<uint64_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+FileAndGroupParent::open_dataset(const char *path)
 {
-    return _create_dataset(path, dims, H5T_STD_U64LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
+    Dataset dataset;
+
+    if (!open_dataset(path, dataset))
+        return NULL;
+
+    return new Dataset(std::move(dataset));
 }
 
-Dataset*
-FileAndGroupParent::_create_dataset(const char *path, const dimensions& dims, hid_t dtype,
-    bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
+bool
+FileAndGroupParent::open_dataset(const char *path, Dataset& dataset)
 {
-    const int N = dims.size();
+    return _open_dataset(path, dataset, true);
+}
 
-    hsize_t d[N];
-    for (int i = 0; i < N; i++)
-        d[i] = dims[i];
+bool
+FileAndGroupParent::try_open_dataset(const char *path, Dataset& dataset)
+{
+    if (!exists(path))
+        return false;
 
-    hid_t   dataspace_id, dataset_id;
+    // Not a dataset
+    _ErrorSilencer  silencer;
 
-    dataspace_id = H5Screate_simple(N, d, NULL);
+    return _open_dataset(path, dataset, false);
+}
 
-    hid_t plist_id  = H5Pcreate(H5P_DATASET_CREATE);
+bool
+FileAndGroupParent::_open_dataset(const char *path, Dataset& dataset, bool report)
+{
+    hid_t   dataset_id;
 
-    // Chunking
-    if (chunk_dims)
-    {
-        const int C = chunk_dims->size();
-        hsize_t c[C];
-        for (int i = 0; i < C; i++)
-            c[i] = (*chunk_dims)[i];
+    _register_fast_filters();
+
+    dataset_id = H5Dopen2(m_id, path, H5P_DEFAULT);
 
-        H5Pset_chunk(plist_id, C, c);
+    if (dataset_id < 0)
+    {
+        if (report)
+            fprintf(stderr, "Failed to open dataset '%s'!\n", path);
+        return false;
     }
 
-    // Shuffling
-    if (shuffle)
-        H5Pset_filter(plist_id, H5Z_FILTER_SHUFFLE, H5Z_FLAG_MANDATORY, 0, NULL);
+    // Get dimensions
 
-    // Deflate compression
-    if (enable_deflate_compression)
-        H5Pset_deflate(plist_id, deflate_level);
+    hid_t           dataspace_id;
+    int             ndims;
+    h5::dimensions  dims;
 
-    dataset_id = H5Dcreate2(m_id, path, dtype,
-        dataspace_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+    dataspace_id = H5Dget_space(dataset_id);
+    if (dataspace_id < 0)
+    {
+        fprintf(stderr, "Could not get dataspace!\n");
+        H5Dclose(dataset_id);
+        return false;
+    }
+
+    ndims = H5Sget_simple_extent_ndims(dataspace_id);
+    if (ndims < 0)
+    {
+        fprintf(stderr, "Could not get dataset dimensions!\n");
+        H5Sclose(dataspace_id);
+        H5Dclose(dataset_id);
+        return false;
+    }
+    
+    hsize_t d[ndims];
+    H5Sget_simple_extent_dims(dataspace_id, d, NULL);
 
     H5Sclose(dataspace_id);
+    
+    for (int i = 0; i < ndims; i++)
+        dims.push_back(d[i]);
 
-    if (dataset_id < 0)
+    dataset = Dataset(dataset_id, dims);
+
+    // External datasets again, with their files relative to this file
+    if (dataset.get_metadata().external)
     {
-        fprintf(stderr, "Failed to create dataset!\n");
-        return NULL;
+        dataset.close();
+
+        dataset_id = H5Dopen2(m_id, path, _dataset_access_plist());
+
+        if (dataset_id < 0)
+        {
+            fprintf(stderr, "Failed to open external dataset '%s'!\n", path);
+            return false;
+        }
+
+        dataset = Dataset(dataset_id, dims);
     }
 
-    return new Dataset(dataset_id, dims);
+    // Done
+
+    return true;
 }
 
-Group*
-FileAndGroupParent::create_group(const char *path)
+// Lookups
+
+bool
+FileAndGroupParent::exists(const char *path)
 {
-    hid_t group_id;
+    if (m_id < 0 || *path == '\0')
+        return false;
 
-    group_id = H5Gcreate(m_id, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    // Keys are absolute paths, so groups share them with their file. Not
+    // for groups without a name (e.g. unlinked), as keys would be wrong
+    const bool  absolute = path[0] == '/';
+    std::string base = absolute ? std::string() : _get_name();
+    std::string prefix, key;
+    std::set<std::string> *missing_paths = absolute || !base.empty() ? m_missing_paths.get() : NULL;
 
-    return new Group(group_id);
-}
+    if (base == "/")
+        base.clear();
 
-//
-// File
-//
+    _ErrorSilencer  silencer;
 
-File::File():
-    FileAndGroupParent()
-{
-}
+    // Each component in turn, as H5Lexists() fails for missing groups
+    const char *p = path;
 
-File::~File()
-{
-    close();
-}
+    while (true)
+    {
+        while (*p == '/')
+            p++;
 
-bool
-File::open(const char *fname, bool readonly)
-{
-    unsigned int flags;
+        if (*p == '\0')
+            break;
 
-    if (readonly)
-        flags = H5F_ACC_RDONLY;
-    else
-        flags = H5F_ACC_RDWR;
+        const char *end = strchr(p, '/');
+        if (end == NULL)
+            end = p + strlen(p);
 
-    m_id = H5Fopen(fname, flags, H5P_DEFAULT);
-    if (m_id < 0)
-        return false;
+        if (absolute || !prefix.empty())
+            prefix += '/';
+        prefix.append(p, end - p);
+        p = end;
 
-    return true;
-}
+        key = base + (absolute ? prefix : "/" + prefix);
 
-bool
-File::create(const char *fname, bool overwrite)
-{
-    /*
-    The flags parameter specifies whether an existing file is to be overwritten.
-    It should be set to either H5F_ACC_TRUNC to overwrite an existing file or H5F_ACC_EXCL,
-    instructing the function to fail if the file already exists.
+        if (missing_paths && missing_paths->count(key) > 0)
+            return false;
 
-    From http://www.hdfgroup.org/HDF5/doc/RM/RM_H5F.html:
+        if (H5Lexists(m_id, prefix.c_str(), H5P_DEFAULT) <= 0)
+            break;
 
-    New files are always created in read-write mode, so the read-write and read-only flags,
-    H5F_ACC_RDWR and H5F_ACC_RDONLY, respectively, are not relevant in this function.
-    Further note that a specification of H5F_ACC_RDONLY will be ignored; the file will
-    be created in read-write mode, regardless.
-    */
+        key.clear();
+    }
 
-    unsigned int flags;
+    // The path itself, or a link to a missing object
+    if (key.empty() && (prefix.empty() || H5Oexists_by_name(m_id, prefix.c_str(), H5P_DEFAULT) > 0))
+        return true;
 
-    if (overwrite)
-        flags = H5F_ACC_TRUNC;
-    else
-        flags = H5F_ACC_EXCL;
+    if (missing_paths)
+    {
+        if (missing_paths->size() >= LOOKUP_CACHE_SIZE)
+            missing_paths->clear();
 
-    m_id = H5Fcreate(fname, flags, H5P_DEFAULT, H5P_DEFAULT);
-    if (m_id < 0)
-        return false;
+        missing_paths->insert(key.empty() ? base + (absolute ? prefix : "/" + prefix) : key);
+    }
 
-    return true;
+    return false;
 }
 
 void
-File::close()
+FileAndGroupParent::clear_lookup_cache()
 {
-    if (m_id == -1)
-        return;
-
-    H5Fclose(m_id);
-    m_id = -1;
+    _invalidate_lookups();
 }
 
-//
-// Group
-//
-
-Group::Group(hid_t group_id):
-    FileAndGroupParent(group_id)
+const std::string&
+FileAndGroupParent::_get_name()
 {
+    if (m_name.empty() && m_id >= 0)
+    {
+        ssize_t length = H5Iget_name(m_id, NULL, 0);
+
+        if (length > 0)
+        {
+            std::vector<char> name(length + 1);
+
+            H5Iget_name(m_id, &name[0], length + 1);
+            m_name = &name[0];
+        }
+    }
+
+    return m_name;
 }
 
-Group::~Group()
+void
+FileAndGroupParent::_invalidate_lookups()
 {
-    close();
+    if (m_missing_paths)
+        m_missing_paths->clear();
 }
 
+// Groups share the missing paths of their file. The group may be this one
 void
-Group::close()
+FileAndGroupParent::_set_group(hid_t group_id, Group& group)
 {
-    if (m_id == -1)
-        return;
+    std::shared_ptr<std::set<std::string> > missing_paths(m_missing_paths);
 
-    H5Gclose(m_id);
-    m_id = -1;
+    group = Group(group_id);
+    group.m_missing_paths = missing_paths;
 }
 
-//
-// Dataset
-//
-
-Dataset::Dataset(hid_t dset_id, const dimensions& dims)
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<float>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    m_dataset_id = dset_id;
-    
-    m_dimensions = dims;
+    return _create_dataset(path, dims, H5T_IEEE_F32LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-Dataset::~Dataset()
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<double>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    H5Dclose(m_dataset_id);
+    return _create_dataset(path, dims, H5T_IEEE_F64LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-int
-Dataset::get_rank() const
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<int8_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    return m_dimensions.size();
+    return _create_dataset(path, dims, H5T_STD_I8LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-void
-Dataset::get_dimensions(dimensions& dims) const
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<int16_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    dims.resize(m_dimensions.size());
-    std::copy(m_dimensions.begin(), m_dimensions.end(), dims.begin());
+    return _create_dataset(path, dims, H5T_STD_I16LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-Type*
-Dataset::get_type() const
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<int32_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    return new Type(H5Dget_type(m_dataset_id));
+    return _create_dataset(path, dims, H5T_STD_I32LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-size_t
-Dataset::get_size_in_bytes() const
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<int64_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    return get_size_in_elements() * get_type()->get_size();
+    return _create_dataset(path, dims, H5T_STD_I64LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-size_t
-Dataset::get_size_in_elements() const
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<uint8_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    size_t  count = 1;
-    for (h5::dimensions::const_iterator it = m_dimensions.begin(), ie = m_dimensions.end(); it != ie; ++it)
-        count *= *it;
-    return count;
+    return _create_dataset(path, dims, H5T_STD_U8LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-size_t
-Dataset::get_size_in_file_bytes() const
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<uint16_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    return H5Dget_storage_size(m_dataset_id);
+    return _create_dataset(path, dims, H5T_STD_U16LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-
-// Dataset::read
-
-template <typename T>
-bool
-Dataset::_read(T* values, hid_t memtype)
+template<>
+Dataset*
+FileAndGroupParent::create_dataset<uint32_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    herr_t  status;
-
-    status = H5Dread(m_dataset_id, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, values);
-
-    return status >= 0;
+    return _create_dataset(path, dims, H5T_STD_U32LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
 template<>
-bool
-Dataset::read<float>(float *values)
+Dataset*
+FileAndGroupParent::create_dataset<uint64_t>(const char *path, const dimensions& dims, bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level)
 {
-    return _read<float>(values, H5T_NATIVE_FLOAT);
+    return _create_dataset(path, dims, H5T_STD_U64LE, shuffle, chunk_dims, enable_deflate_compression, deflate_level);
 }
 
-template<>
-bool
-Dataset::read<double>(double *values)
+template <typename T>
+Dataset*
+FileAndGroupParent::create_dataset(const char *path, const dimensions& dims, const DatasetCreationOptions& options)
 {
-    return _read<double>(values, H5T_NATIVE_DOUBLE);
+    return _create_dataset(path, dims, file_type<T>(), options);
 }
 
-template<>
+template <typename T>
 bool
-Dataset::read<int8_t>(int8_t *values)
+FileAndGroupParent::create_dataset(const char *path, const dimensions& dims, const DatasetCreationOptions& options,
+    Dataset& dataset)
 {
-    return _read<int8_t>(values, H5T_NATIVE_INT8);
+    return _create_dataset(path, dims, file_type<T>(), options, dataset);
 }
 
-template<>
-bool
-Dataset::read<int16_t>(int16_t *values)
+template <typename T>
+Dataset*
+FileAndGroupParent::create_appendable_dataset(const char *path, const dimensions& dims, const dimensions& chunk_dims,
+    bool shuffle, bool enable_deflate_compression, int deflate_level)
 {
-    return _read<int16_t>(values, H5T_NATIVE_INT16);
+    return _create_dataset(path, dims, file_type<T>(), shuffle, &chunk_dims, enable_deflate_compression, deflate_level, true);
 }
 
-template<>
-bool
-Dataset::read<int32_t>(int32_t *values)
+Dataset*
+FileAndGroupParent::_create_dataset(const char *path, const dimensions& dims, hid_t dtype,
+    bool shuffle, const dimensions *chunk_dims, bool enable_deflate_compression, int deflate_level,
+    bool appendable)
 {
-    return _read<int32_t>(values, H5T_NATIVE_INT32);
+    // Same behaviour as before creation options existed, i.e. HDF5
+    // defaults for anything not specified
+    DatasetCreationOptions  options;
+
+    options.layout = chunk_dims ? DatasetCreationOptions::LAYOUT_CHUNKED : DatasetCreationOptions::LAYOUT_CONTIGUOUS;
+    if (chunk_dims)
+        options.chunk_dims = *chunk_dims;
+    if (appendable)
+    {
+        options.max_dims = dims;
+        options.max_dims[0] = UNLIMITED;
+    }
+    options.shuffle = shuffle;
+    options.compression = enable_deflate_compression ? DatasetCreationOptions::COMPRESSION_DEFLATE : DatasetCreationOptions::COMPRESSION_NONE;
+    options.compression_level = deflate_level;
+    options.fill_time = DatasetCreationOptions::FILL_TIME_DEFAULT;
+    options.alloc_time = DatasetCreationOptions::ALLOC_TIME_DEFAULT;
+
+    return _create_dataset(path, dims, dtype, options);
 }
 
-template<>
-bool
-Dataset::read<int64_t>(int64_t *values)
+Dataset*
+FileAndGroupParent::_create_dataset(const char *path, const dimensions& dims, hid_t dtype,
+    const DatasetCreationOptions& options)
 {
-    return _read<int64_t>(values, H5T_NATIVE_INT64);
+    Dataset dataset;
+
+    if (!_create_dataset(path, dims, dtype, options, dataset))
+        return NULL;
+
+    return new Dataset(std::move(dataset));
 }
 
-template<>
 bool
-Dataset::read<uint8_t>(uint8_t *values)
+FileAndGroupParent::_create_dataset(const char *path, const dimensions& dims, hid_t dtype,
+    const DatasetCreationOptions& options, Dataset& dataset)
 {
-    return _read<uint8_t>(values, H5T_NATIVE_UINT8);
+    const int N = dims.size();
+
+    _invalidate_lookups();
+
+    if (!options.max_dims.empty() && (int)options.max_dims.size() != N)
+    {
+        fprintf(stderr, "Maximum dimensions don't match dataset rank!\n");
+        return false;
+    }
+
+    if (!options.chunk_dims.empty() && (int)options.chunk_dims.size() != N)
+    {
+        fprintf(stderr, "Chunk dimensions don't match dataset rank!\n");
+        return false;
+    }
+
+    hsize_t d[N], maxd[N];
+    bool    resizable = false;
+    hsize_t bytes = H5Tget_size(dtype);
+
+    for (int i = 0; i < N; i++)
+    {
+        d[i] = maxd[i] = dims[i];
+        if (!options.max_dims.empty())
+            maxd[i] = options.max_dims[i] == UNLIMITED ? H5S_UNLIMITED : options.max_dims[i];
+        if (maxd[i] != d[i])
+            resizable = true;
+        bytes *= d[i];
+    }
+
+    // Layout
+
+    const bool filtered = options.shuffle || options.compression != DatasetCreationOptions::COMPRESSION_NONE;
+
+    DatasetCreationOptions::Layout  layout = options.layout;
+
+    if (layout == DatasetCreationOptions::LAYOUT_AUTO)
+    {
+        if (filtered || resizable || !options.chunk_dims.empty())
+            layout = DatasetCreationOptions::LAYOUT_CHUNKED;
+        else if (bytes <= options.compact_size_limit)
+            layout = DatasetCreationOptions::LAYOUT_COMPACT;
+        else
+            layout = DatasetCreationOptions::LAYOUT_CONTIGUOUS;
+    }
+    else if (layout != DatasetCreationOptions::LAYOUT_CHUNKED && (filtered || resizable))
+    {
+        fprintf(stderr, "Filters and resizing need a chunked layout!\n");
+        return false;
+    }
+
+    hid_t plist_id  = H5Pcreate(H5P_DATASET_CREATE);
+
+    switch (layout)
+    {
+    case DatasetCreationOptions::LAYOUT_COMPACT:
+        H5Pset_layout(plist_id, H5D_COMPACT);
+        break;
+    case DatasetCreationOptions::LAYOUT_CONTIGUOUS:
+        H5Pset_layout(plist_id, H5D_CONTIGUOUS);
+        break;
+    default:
+        {
+            // Chunking. Unless given, aim for chunks of about chunk_size_target
+            // bytes, by halving the largest chunk dimension
+            hsize_t c[N];
+            if (!options.chunk_dims.empty())
+            {
+                for (int i = 0; i < N; i++)
+                    c[i] = options.chunk_dims[i];
+            }
+            else
+            {
+                const size_t element_size = H5Tget_size(dtype);
+                hsize_t row = element_size;
+
+                for (int i = N-1; i >= 0; i--)
+                {
+                    c[i] = std::max(d[i], (hsize_t)1);
+                    if (i == 0 && maxd[0] != d[0])
+                        c[0] = std::max(options.chunk_size_target / row, (hsize_t)1);
+                    row *= c[i];
+                }
+
+                while (row > options.chunk_size_target)
+                {
+                    int largest = 0;
+                    for (int i = 1; i < N; i++)
+                        if (c[i] > c[largest])
+                            largest = i;
+
+                    if (c[largest] == 1)
+                        break;
+
+                    row /= c[largest];
+                    c[largest] = (c[largest] + 1) / 2;
+                    row *= c[largest];
+                }
+            }
+
+            H5Pset_chunk(plist_id, N, c);
+        }
+    }
+
+    // Shuffling
+    if (options.shuffle)
+        H5Pset_filter(plist_id, H5Z_FILTER_SHUFFLE, H5Z_FLAG_MANDATORY, 0, NULL);
+
+    // Compression
+    if (options.compression == DatasetCreationOptions::COMPRESSION_DEFLATE)
+        H5Pset_deflate(plist_id, _compression_level(options));
+    else if (options.compression != DatasetCreationOptions::COMPRESSION_NONE &&
+        !_set_fast_filter(plist_id, dtype, options))
+    {
+        H5Pclose(plist_id);
+        return false;
+    }
+
+    // Fill values and space allocation
+    if (options.fill_time == DatasetCreationOptions::FILL_TIME_NEVER)
+        H5Pset_fill_time(plist_id, H5D_FILL_TIME_NEVER);
+    else if (options.fill_time == DatasetCreationOptions::FILL_TIME_ALLOC)
+        H5Pset_fill_time(plist_id, H5D_FILL_TIME_ALLOC);
+
+    switch (options.alloc_time)
+    {
+    case DatasetCreationOptions::ALLOC_TIME_AUTO:
+        if (layout == DatasetCreationOptions::LAYOUT_COMPACT)
+            H5Pset_alloc_time(plist_id, H5D_ALLOC_TIME_EARLY);
+        else if (layout == DatasetCreationOptions::LAYOUT_CONTIGUOUS)
+            H5Pset_alloc_time(plist_id, H5D_ALLOC_TIME_LATE);
+        else
+            H5Pset_alloc_time(plist_id, H5D_ALLOC_TIME_INCR);
+        break;
+    case DatasetCreationOptions::ALLOC_TIME_EARLY:
+        H5Pset_alloc_time(plist_id, H5D_ALLOC_TIME_EARLY);
+        break;
+    case DatasetCreationOptions::ALLOC_TIME_LATE:
+        H5Pset_alloc_time(plist_id, H5D_ALLOC_TIME_LATE);
+        break;
+    case DatasetCreationOptions::ALLOC_TIME_INCREMENTAL:
+        H5Pset_alloc_time(plist_id, H5D_ALLOC_TIME_INCR);
+        break;
+    default:
+        break;
+    }
+
+    hid_t   dataspace_id, dataset_id;
+
+    dataspace_id = H5Screate_simple(N, d, maxd);
+
+    dataset_id = H5Dcreate2(m_id, path, dtype,
+        dataspace_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+
+    H5Sclose(dataspace_id);
+    H5Pclose(plist_id);
+
+    if (dataset_id < 0)
+    {
+        fprintf(stderr, "Failed to create dataset!\n");
+        return false;
+    }
+
+    dataset = Dataset(dataset_id, dims);
+
+    return true;
 }
 
-template<>
-bool
-Dataset::read<uint16_t>(uint16_t *values)
+Group*
+FileAndGroupParent::create_group(const char *path)
 {
-    return _read<uint16_t>(values, H5T_NATIVE_UINT16);
+    hid_t group_id;
+
+    _invalidate_lookups();
+
+    group_id = H5Gcreate(m_id, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+
+    Group *group = new Group(group_id);
+    group->m_missing_paths = m_missing_paths;
+
+    return group;
 }
 
-template<>
-bool
-Dataset::read<uint32_t>(uint32_t *values)
+static hid_t
+_string_type(size_t length)
 {
-    return _read<uint32_t>(values, H5T_NATIVE_UINT32);
+    hid_t   type_id = H5Tcopy(H5T_C_S1);
+
+    H5Tset_size(type_id, length == 0 ? H5T_VARIABLE : length);
+    H5Tset_cset(type_id, H5T_CSET_UTF8);
+    if (length > 0)
+        H5Tset_strpad(type_id, H5T_STR_NULLPAD);
+
+    return type_id;
 }
 
-template<>
 bool
-Dataset::read<uint64_t>(uint64_t *values)
+FileAndGroupParent::create_string_dataset(const char *path, const dimensions& dims, size_t length,
+    const DatasetCreationOptions& options, Dataset& dataset)
 {
-    return _read<uint64_t>(values, H5T_NATIVE_UINT64);
-}
+    hid_t   dtype = _string_type(length);
 
-// Dataset::write
+    DatasetCreationOptions  string_options(options);
 
-template <typename T>
-bool
-Dataset::_write(const T* values, hid_t memtype)
-{
-    herr_t  status;
+    // Variable-length data needs its fill value written, even when
+    // never read
+    if (length == 0 && string_options.fill_time == DatasetCreationOptions::FILL_TIME_NEVER)
+        string_options.fill_time = DatasetCreationOptions::FILL_TIME_DEFAULT;
 
-    status = H5Dwrite(m_dataset_id, memtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, values);
+    bool ok = _create_dataset(path, dims, dtype, string_options, dataset);
 
-    return status >= 0;
-}
+    H5Tclose(dtype);
 
-template<>
-bool
-Dataset::write<float>(float *values)
-{
-    return _write<float>(values, H5T_NATIVE_FLOAT);
+    return ok;
 }
 
-template<>
 bool
-Dataset::write<double>(double *values)
+FileAndGroupParent::create_group(const char *path, Group& group)
 {
-    return _write<double>(values, H5T_NATIVE_DOUBLE);
+    hid_t group_id;
+
+    _invalidate_lookups();
+
+    group_id = H5Gcreate(m_id, path, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if (group_id < 0)
+        return false;
+
+    _set_group(group_id, group);
+
+    return true;
 }
 
-template<>
-bool
-Dataset::write<int8_t>(int8_t *values)
+// Groups in files whose lower format bound is the earliest one (the
+// default) are symbol tables. With upgrade raises the bound to 1.8, so new
+// groups get link storage, otherwise fails
+static bool
+_use_link_storage(hid_t id, const char *path, bool upgrade)
 {
-    return _write<int8_t>(values, H5T_NATIVE_INT8);
+    hid_t           file_id = H5Iget_file_id(id);
+    hid_t           fapl_id = H5Fget_access_plist(file_id);
+    H5F_libver_t    low, high;
+    bool            ok = H5Pget_libver_bounds(fapl_id, &low, &high) >= 0;
+
+    H5Pclose(fapl_id);
+
+    if (ok && low < H5F_LIBVER_V18)
+    {
+        if (upgrade)
+            ok = H5Fset_libver_bounds(file_id, H5F_LIBVER_V18, std::max(high, H5F_LIBVER_V18)) >= 0;
+        else
+        {
+            fprintf(stderr, "Group '%s' needs a file in the 1.8 format or later, see GroupCreationOptions!\n", path);
+            ok = false;
+        }
+    }
+
+    H5Fclose(file_id);
+
+    return ok;
 }
 
-template<>
 bool
-Dataset::write<int16_t>(int16_t *values)
+FileAndGroupParent::create_group(const char *path, const GroupCreationOptions& options, Group& group)
 {
-    return _write<int16_t>(values, H5T_NATIVE_INT16);
+    hid_t   lcpl_id = H5Pcreate(H5P_LINK_CREATE);
+    hid_t   gcpl_id = H5Pcreate(H5P_GROUP_CREATE);
+    hid_t   group_id;
+
+    if (options.create_intermediate)
+        H5Pset_create_intermediate_group(lcpl_id, 1);
+
+    H5Pset_link_phase_change(gcpl_id, options.max_compact, options.min_dense);
+
+    if (options.estimated_entries > 0 || options.estimated_name_length > 0)
+    {
+        const unsigned entries = options.estimated_entries > 0 ? options.estimated_entries : 4;
+        const unsigned name_length = options.estimated_name_length > 0 ? options.estimated_name_length : 8;
+
+        // Entries only size the compact storage (and can't exceed 64K)
+        H5Pset_est_link_info(gcpl_id, std::min(entries, 65535u), std::min(name_length, 65535u));
+    }
+
+    if (options.track_creation_order)
+        H5Pset_link_creation_order(gcpl_id, H5P_CRT_ORDER_TRACKED | H5P_CRT_ORDER_INDEXED);
+
+    // Otherwise a symbol table, ignoring the link storage settings
+    if ((options.max_compact != 8 || options.min_dense != 6) &&
+        !_use_link_storage(m_id, path, options.upgrade_file_format))
+    {
+        H5Pclose(gcpl_id);
+        H5Pclose(lcpl_id);
+        return false;
+    }
+
+    _invalidate_lookups();
+
+    group_id = H5Gcreate2(m_id, path, lcpl_id, gcpl_id, H5P_DEFAULT);
+
+    H5Pclose(gcpl_id);
+    H5Pclose(lcpl_id);
+
+    if (group_id < 0)
+        return false;
+
+    _set_group(group_id, group);
+
+    return true;
 }
 
-template<>
 bool
-Dataset::write<int32_t>(int32_t *values)
+FileAndGroupParent::open_group(const char *path, Group& group)
 {
-    return _write<int32_t>(values, H5T_NATIVE_INT32);
+    hid_t group_id;
+
+    group_id = H5Gopen2(m_id, path, H5P_DEFAULT);
+    if (group_id < 0)
+        return false;
+
+    _set_group(group_id, group);
+
+    return true;
 }
 
-template<>
+// Object copies
+
 bool
-Dataset::write<int64_t>(int64_t *values)
+FileAndGroupParent::copy_object(FileAndGroupParent& src_parent, const char *src_path,
+    FileAndGroupParent& dst_parent, const char *dst_path)
+{
+    hid_t   lcpl_id = H5Pcreate(H5P_LINK_CREATE);
+    herr_t  status;
+
+    H5Pset_create_intermediate_group(lcpl_id, 1);
+
+    dst_parent._invalidate_lookups();
+
+    status = H5Ocopy(src_parent.m_id, src_path, dst_parent.m_id, dst_path, H5P_DEFAULT, lcpl_id);
+
+    H5Pclose(lcpl_id);
+
+    if (status < 0)
+    {
+        fprintf(stderr, "Failed to copy %s to %s\n", src_path, dst_path);
+        return false;
+    }
+
+    return true;
+}
+
+static herr_t
+_collect_link_name(hid_t group_id, const char *name, const H5L_info_t *info, void *op_data)
+{
+    (void)group_id;
+    (void)info;
+
+    ((std::vector<std::string>*)op_data)->push_back(name);
+
+    return 0;
+}
+
+bool
+FileAndGroupParent::copy_group_members(FileAndGroupParent& src_parent, const char *src_path,
+    FileAndGroupParent& dst_parent, const char *dst_path)
+{
+    hid_t   src_group_id, dst_group_id;
+
+    dst_parent._invalidate_lookups();
+
+    src_group_id = H5Gopen2(src_parent.m_id, src_path, H5P_DEFAULT);
+    if (src_group_id < 0)
+        return false;
+
+    // Member names first, as copying while iterating isn't allowed
+    // when source and destination are the same file
+    std::vector<std::string> names;
+
+    if (H5Literate(src_group_id, H5_INDEX_NAME, H5_ITER_NATIVE, NULL, _collect_link_name, &names) < 0)
+    {
+        H5Gclose(src_group_id);
+        return false;
+    }
+
+    hid_t   lcpl_id = H5Pcreate(H5P_LINK_CREATE);
+
+    H5Pset_create_intermediate_group(lcpl_id, 1);
+
+    if (H5Lexists(dst_parent.m_id, dst_path, H5P_DEFAULT) > 0)
+        dst_group_id = H5Gopen2(dst_parent.m_id, dst_path, H5P_DEFAULT);
+    else
+        dst_group_id = H5Gcreate2(dst_parent.m_id, dst_path, lcpl_id, H5P_DEFAULT, H5P_DEFAULT);
+
+    bool    ok = dst_group_id >= 0;
+
+    for (size_t i = 0; ok && i < names.size(); i++)
+    {
+        const char *name = names[i].c_str();
+
+        if (H5Ocopy(src_group_id, name, dst_group_id, name, H5P_DEFAULT, lcpl_id) < 0)
+        {
+            fprintf(stderr, "Failed to copy %s/%s to %s\n", src_path, name, dst_path);
+            ok = false;
+        }
+    }
+
+    H5Pclose(lcpl_id);
+    if (dst_group_id >= 0)
+        H5Gclose(dst_group_id);
+    H5Gclose(src_group_id);
+
+    return ok;
+}
+
+// Group creation options
+
+GroupCreationOptions::GroupCreationOptions()
+{
+    max_compact = 0;
+    min_dense = 0;
+    estimated_entries = 0;
+    estimated_name_length = 0;
+    track_creation_order = false;
+    create_intermediate = true;
+    upgrade_file_format = false;
+}
+
+// Dataset metadata
+
+DatasetMetadata::DatasetMetadata()
+{
+    type_class = Type::NONE;
+    is_signed = false;
+    element_size = 0;
+    native_element_size = 0;
+    layout = LAYOUT_CONTIGUOUS;
+    external = false;
+    storage_size = 0;
+}
+
+// Dataset creation options
+
+DatasetCreationOptions::DatasetCreationOptions()
+{
+    layout = LAYOUT_AUTO;
+    shuffle = false;
+    compression = COMPRESSION_NONE;
+    compression_level = COMPRESSION_LEVEL_DEFAULT;
+    compression_threads = 1;
+    fill_time = FILL_TIME_NEVER;
+    alloc_time = ALLOC_TIME_AUTO;
+    compact_size_limit = 16*1024;
+    chunk_size_target = 1024*1024;
+}
+
+// Memory layouts
+
+MemoryLayout::MemoryLayout()
+{
+    offset = 0;
+}
+
+MemoryLayout::MemoryLayout(const dimensions& extents):
+    extents(extents), strides(extents.size())
+{
+    const int N = extents.size();
+
+    offset = 0;
+
+    hsize_t stride = 1;
+    for (int i = N-1; i >= 0; i--)
+    {
+        strides[i] = stride;
+        stride *= extents[i];
+    }
+}
+
+MemoryLayout
+MemoryLayout::column_major(const dimensions& extents)
+{
+    MemoryLayout    layout(extents);
+
+    hsize_t stride = 1;
+    for (size_t i = 0; i < extents.size(); i++)
+    {
+        layout.strides[i] = stride;
+        stride *= extents[i];
+    }
+
+    return layout;
+}
+
+MemoryLayout
+MemoryLayout::interleaved(const dimensions& extents, int field, int num_fields)
+{
+    MemoryLayout    layout(extents);
+
+    for (size_t i = 0; i < extents.size(); i++)
+        layout.strides[i] *= num_fields;
+    layout.offset = field;
+
+    return layout;
+}
+
+// Virtual datasets
+
+template <typename T>
+bool
+FileAndGroupParent::create_virtual_dataset(const char *path, const dimensions& dims,
+    const std::vector<VirtualSource>& sources, Dataset& dataset)
+{
+    return _create_virtual_dataset(path, dims, file_type<T>(), sources, dataset);
+}
+
+bool
+FileAndGroupParent::_create_virtual_dataset(const char *path, const dimensions& dims, hid_t dtype,
+    const std::vector<VirtualSource>& sources, Dataset& dataset)
+{
+    const int N = dims.size();
+
+    _invalidate_lookups();
+
+    hsize_t d[N], start[N], cnt[N], src_dims[N], src_start[N];
+    for (int i = 0; i < N; i++)
+        d[i] = dims[i];
+
+    hid_t   dataspace_id, dataset_id;
+    hid_t   plist_id = H5Pcreate(H5P_DATASET_CREATE);
+
+    dataspace_id = H5Screate_simple(N, d, NULL);
+
+    for (std::vector<VirtualSource>::const_iterator it = sources.begin(), ie = sources.end(); it != ie; ++it)
+    {
+        if ((int)it->offset.size() != N || (int)it->count.size() != N ||
+            (!it->source_offset.empty() && (int)it->source_offset.size() != N))
+        {
+            fprintf(stderr, "Virtual dataset source doesn't match dataset rank!\n");
+            H5Sclose(dataspace_id);
+            H5Pclose(plist_id);
+            return false;
+        }
+
+        for (int i = 0; i < N; i++)
+        {
+            start[i] = it->offset[i];
+            cnt[i] = it->count[i];
+            src_start[i] = it->source_offset.empty() ? 0 : it->source_offset[i];
+            src_dims[i] = src_start[i] + cnt[i];
+        }
+
+        H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, start, NULL, cnt, NULL);
+
+        hid_t src_space_id = H5Screate_simple(N, src_dims, NULL);
+        H5Sselect_hyperslab(src_space_id, H5S_SELECT_SET, src_start, NULL, cnt, NULL);
+
+        herr_t status = H5Pset_virtual(plist_id, dataspace_id, it->filename.c_str(), it->path.c_str(), src_space_id);
+
+        H5Sclose(src_space_id);
+
+        if (status < 0)
+        {
+            fprintf(stderr, "Failed to map virtual dataset source '%s:%s'!\n", it->filename.c_str(), it->path.c_str());
+            H5Sclose(dataspace_id);
+            H5Pclose(plist_id);
+            return false;
+        }
+    }
+
+    H5Sselect_all(dataspace_id);
+
+    dataset_id = H5Dcreate2(m_id, path, dtype, dataspace_id, H5P_DEFAULT, plist_id, H5P_DEFAULT);
+
+    H5Sclose(dataspace_id);
+    H5Pclose(plist_id);
+
+    if (dataset_id < 0)
+    {
+        fprintf(stderr, "Failed to create virtual dataset!\n");
+        return false;
+    }
+
+    dataset = Dataset(dataset_id, dims);
+
+    return true;
+}
+
+// External datasets
+
+template <typename T>
+bool
+FileAndGroupParent::create_external_dataset(const char *path, const dimensions& dims,
+    const std::vector<ExternalFile>& files, Dataset& dataset)
+{
+    return _create_external_dataset(path, dims, file_type<T>(), files, dataset);
+}
+
+bool
+FileAndGroupParent::_create_external_dataset(const char *path, const dimensions& dims, hid_t dtype,
+    const std::vector<ExternalFile>& files, Dataset& dataset)
+{
+    const int N = dims.size();
+
+    _invalidate_lookups();
+
+    hsize_t d[N];
+    hsize_t bytes = H5Tget_size(dtype);
+    for (int i = 0; i < N; i++)
+    {
+        d[i] = dims[i];
+        bytes *= d[i];
+    }
+
+    hsize_t total = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        if (files[i].size == 0 && i + 1 < files.size())
+        {
+            fprintf(stderr, "Only the last external file can have an open size!\n");
+            return false;
+        }
+
+        total = files[i].size == 0 ? bytes : total + files[i].size;
+    }
+
+    if (total < bytes)
+    {
+        fprintf(stderr, "External files hold %llu bytes, the dataset needs %llu!\n",
+            (unsigned long long)total, (unsigned long long)bytes);
+        return false;
+    }
+
+    // The raw files must already hold their part of the data
+    hsize_t remaining = bytes;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        const std::string   name = _external_file_path(m_id, files[i].filename);
+        const hsize_t       needed = files[i].offset + (files[i].size == 0 ? remaining : files[i].size);
+        struct stat         st;
+
+        if (stat(name.c_str(), &st) != 0)
+        {
+            fprintf(stderr, "External file '%s' doesn't exist!\n", name.c_str());
+            return false;
+        }
+
+        if ((hsize_t)st.st_size < needed)
+        {
+            fprintf(stderr, "External file '%s' holds %llu bytes, needs %llu!\n", name.c_str(),
+                (unsigned long long)st.st_size, (unsigned long long)needed);
+            return false;
+        }
+
+        remaining -= std::min(remaining, files[i].size == 0 ? remaining : files[i].size);
+    }
+
+    hid_t   dataspace_id, dataset_id;
+    hid_t   plist_id = H5Pcreate(H5P_DATASET_CREATE);
+
+    for (std::vector<ExternalFile>::const_iterator it = files.begin(), ie = files.end(); it != ie; ++it)
+    {
+        if (H5Pset_external(plist_id, it->filename.c_str(), it->offset, it->size == 0 ? H5F_UNLIMITED : it->size) < 0)
+        {
+            fprintf(stderr, "Invalid external file '%s'!\n", it->filename.c_str());
+            H5Pclose(plist_id);
+            return false;
+        }
+    }
+
+    dataspace_id = H5Screate_simple(N, d, NULL);
+
+    dataset_id = H5Dcreate2(m_id, path, dtype, dataspace_id, H5P_DEFAULT, plist_id, _dataset_access_plist());
+
+    H5Sclose(dataspace_id);
+    H5Pclose(plist_id);
+
+    if (dataset_id < 0)
+    {
+        fprintf(stderr, "Failed to create external dataset!\n");
+        return false;
+    }
+
+    dataset = Dataset(dataset_id, dims);
+
+    return true;
+}
+
+// Repacking
+
+RepackOptions::RepackOptions()
+{
+    shuffle = false;
+    enable_deflate_compression = false;
+    deflate_level = 7;
+    memory_budget = 256*1024*1024;
+}
+
+static int
+_gcd(int a, int b)
+{
+    while (b != 0)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Copy a block with source dimensions src_dims into dst, in the axis
+// order given by axis_order (destination axis i is source axis axis_order[i])
+static void
+_permute_block(char *dst, const char *src, const hsize_t *src_dims, const std::vector<int>& axis_order, size_t element_size)
+{
+    const int N = axis_order.size();
+
+    hsize_t src_strides[N], strides[N], dims[N], index[N];
+
+    src_strides[N-1] = element_size;
+    for (int i = N-2; i >= 0; i--)
+        src_strides[i] = src_strides[i+1] * src_dims[i+1];
+
+    for (int i = 0; i < N; i++)
+    {
+        dims[i] = src_dims[axis_order[i]];
+        strides[i] = src_strides[axis_order[i]];
+        index[i] = 0;
+        if (dims[i] == 0)
+            return;
+    }
+
+    const hsize_t   inner_count = dims[N-1];
+    const hsize_t   inner_stride = strides[N-1];
+    const char      *s;
+
+    while (true)
+    {
+        s = src;
+        for (int i = 0; i < N-1; i++)
+            s += index[i] * strides[i];
+
+        switch (element_size)
+        {
+        case 1:
+            for (hsize_t j = 0; j < inner_count; j++, dst += 1, s += inner_stride)
+                *dst = *s;
+            break;
+        case 4:
+            for (hsize_t j = 0; j < inner_count; j++, dst += 4, s += inner_stride)
+                memcpy(dst, s, 4);
+            break;
+        case 8:
+            for (hsize_t j = 0; j < inner_count; j++, dst += 8, s += inner_stride)
+                memcpy(dst, s, 8);
+            break;
+        default:
+            for (hsize_t j = 0; j < inner_count; j++, dst += element_size, s += inner_stride)
+                memcpy(dst, s, element_size);
+        }
+
+        int d = N - 2;
+        for (; d >= 0; d--)
+        {
+            if (++index[d] < dims[d])
+                break;
+            index[d] = 0;
+        }
+
+        if (d < 0)
+            break;
+    }
+}
+
+Dataset*
+FileAndGroupParent::repack_dataset(const char *path, Dataset *source, const RepackOptions& options,
+    RepackStatistics *statistics)
+{
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    dimensions  src_dims, src_chunk_dims, dims;
+
+    source->get_dimensions(src_dims);
+
+    const int N = src_dims.size();
+
+    // Destination axis order
+
+    std::vector<int>    axis_order(options.axis_order);
+    bool                permuted = false;
+
+    if (axis_order.empty())
+    {
+        for (int i = 0; i < N; i++)
+            axis_order.push_back(i);
+    }
+    else
+    {
+        std::vector<int> check(axis_order);
+        std::sort(check.begin(), check.end());
+        for (int i = 0; i < N; i++)
+        {
+            if ((int)check.size() != N || check[i] != i)
+            {
+                fprintf(stderr, "Invalid axis order for repacking!\n");
+                return NULL;
+            }
+            if (axis_order[i] != i)
+                permuted = true;
+        }
+    }
+
+    for (int i = 0; i < N; i++)
+        dims.push_back(src_dims[axis_order[i]]);
+
+    if (!options.chunk_dims.empty() && (int)options.chunk_dims.size() != N)
+    {
+        fprintf(stderr, "Chunk dimensions don't match dataset rank!\n");
+        return NULL;
+    }
+
+    // Element type
+
+    hid_t   file_type_id = H5Dget_type(source->get_id());
+    hid_t   mem_type_id = H5Tget_native_type(file_type_id, H5T_DIR_ASCEND);
+    size_t  element_size = H5Tget_size(mem_type_id);
+
+    Dataset *dset = _create_dataset(path, dims, file_type_id, options.shuffle,
+        options.chunk_dims.empty() ? NULL : &options.chunk_dims,
+        options.enable_deflate_compression, options.deflate_level);
+
+    H5Tclose(file_type_id);
+
+    if (dset == NULL)
+    {
+        H5Tclose(mem_type_id);
+        return NULL;
+    }
+
+    // Plan the slab shape (in destination axis order). The basic unit is
+    // aligned to both the source and destination chunk grids, so each
+    // chunk gets read and written (and compressed) exactly once. That unit
+    // then gets grown to fill the memory budget, fastest varying axis first.
+    // Permuting needs a second buffer.
+
+    const size_t    buffers = permuted ? 2 : 1;
+    const size_t    budget = options.memory_budget / (buffers * element_size);
+    bool            src_chunked = source->get_chunk_dimensions(src_chunk_dims);
+    hsize_t         unit[N], slab[N];
+    size_t          unit_elements = 1;
+
+    for (int i = 0; i < N; i++)
+    {
+        int s = src_chunked ? src_chunk_dims[axis_order[i]] : 1;
+        int d = options.chunk_dims.empty() ? 1 : options.chunk_dims[i];
+
+        unit[i] = std::min((hsize_t)(s / _gcd(s, d)) * d, (hsize_t)std::max(dims[i], 1));
+        unit_elements *= unit[i];
+    }
+
+    if (unit_elements > budget)
+    {
+        // Can't align to both grids within budget, only align to the
+        // destination chunks, then give up on full alignment
+        unit_elements = 1;
+        for (int i = 0; i < N; i++)
+        {
+            unit[i] = options.chunk_dims.empty() ? 1 : std::min(options.chunk_dims[i], std::max(dims[i], 1));
+            unit_elements *= unit[i];
+        }
+
+        for (int i = 0; i < N-1 && unit_elements > budget; i++)
+        {
+            unit_elements /= unit[i];
+            unit[i] = 1;
+        }
+
+        fprintf(stderr, "Memory budget too small for chunk-aligned repacking, this will be slow!\n");
+    }
+
+    size_t  slab_elements = unit_elements;
+    int     axis = N - 1;
+
+    for (; axis >= 0; axis--)
+    {
+        size_t  others = slab_elements / unit[axis];
+        hsize_t factor = std::max(budget / (others * unit[axis]), (hsize_t)1);
+
+        slab[axis] = std::min(unit[axis] * factor, (hsize_t)std::max(dims[axis], 1));
+        slab_elements = others * slab[axis];
+
+        // Only grow outer axes when this one spans the full extent
+        if (slab[axis] < (hsize_t)dims[axis])
+            break;
+    }
+
+    for (int i = axis-1; i >= 0; i--)
+        slab[i] = unit[i];
+
+    // Copy slab by slab
+
+    std::vector<char>   buffer(slab_elements * element_size);
+    std::vector<char>   permuted_buffer(permuted ? slab_elements * element_size : 0);
+
+    hid_t   src_space_id = H5Dget_space(source->get_id());
+    hid_t   dst_space_id = H5Dget_space(dset->get_id());
+    hid_t   mem_space_id;
+
+    hsize_t start[N], count[N], src_start[N], src_count[N];
+    hsize_t bytes = 0;
+    int     slabs = 0;
+    bool    empty = false, ok = true;
+
+    for (int i = 0; i < N; i++)
+    {
+        start[i] = 0;
+        if (dims[i] == 0)
+            empty = true;
+    }
+
+    while (!empty)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            count[i] = std::min(slab[i], dims[i] - start[i]);
+            src_start[axis_order[i]] = start[i];
+            src_count[axis_order[i]] = count[i];
+        }
+
+        H5Sselect_hyperslab(src_space_id, H5S_SELECT_SET, src_start, NULL, src_count, NULL);
+        mem_space_id = H5Screate_simple(N, src_count, NULL);
+
+        ok = H5Dread(source->get_id(), mem_type_id, mem_space_id, src_space_id, H5P_DEFAULT, &buffer[0]) >= 0;
+
+        H5Sclose(mem_space_id);
+
+        if (!ok)
+            break;
+
+        char *data = &buffer[0];
+        if (permuted)
+        {
+            _permute_block(&permuted_buffer[0], &buffer[0], src_count, axis_order, element_size);
+            data = &permuted_buffer[0];
+        }
+
+        H5Sselect_hyperslab(dst_space_id, H5S_SELECT_SET, start, NULL, count, NULL);
+        mem_space_id = H5Screate_simple(N, count, NULL);
+
+        ok = H5Dwrite(dset->get_id(), mem_type_id, mem_space_id, dst_space_id, H5P_DEFAULT, data) >= 0;
+
+        H5Sclose(mem_space_id);
+
+        if (!ok)
+            break;
+
+        hsize_t n = element_size;
+        for (int i = 0; i < N; i++)
+            n *= count[i];
+        bytes += n;
+        slabs++;
+
+        // Next slab, last axis varying fastest
+        int d = N - 1;
+        for (; d >= 0; d--)
+        {
+            start[d] += slab[d];
+            if (start[d] < (hsize_t)dims[d])
+                break;
+            start[d] = 0;
+        }
+
+        if (d < 0)
+            break;
+    }
+
+    H5Sclose(src_space_id);
+    H5Sclose(dst_space_id);
+    H5Tclose(mem_type_id);
+
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to repack dataset!\n");
+        delete dset;
+        return NULL;
+    }
+
+    if (statistics)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+
+        statistics->bytes = bytes;
+        statistics->slabs = slabs;
+        statistics->seconds = elapsed.count();
+        statistics->throughput = statistics->seconds > 0.0 ? bytes / statistics->seconds : 0.0;
+    }
+
+    return dset;
+}
+
+//
+// POSIX file driver
+//
+// HDF5 virtual file driver on plain POSIX I/O, used for direct I/O when
+// the HDF5 library lacks its direct driver and for I/O monitoring. The
+// driver class is filled in field by field, as its layout differs between
+// HDF5 versions.
+//
+
+IOMonitor::IOMonitor()
+{
+    latency = 0.0;
+    bandwidth = 0.0;
+    log = false;
+    reset();
+}
+
+void
+IOMonitor::reset()
+{
+    reads = writes = 0;
+    bytes_read = bytes_written = 0;
+    delay = 0.0;
+    operations.clear();
+}
+
+struct _PosixDriverConfig
+{
+    bool        direct;             // Use O_DIRECT where supported
+    size_t      alignment;          // For direct I/O, a power of 2
+    IOMonitor   *monitor;           // Can be NULL
+};
+
+struct _PosixFile
+{
+    H5FD_t      pub;                // Must come first
+    int         fd;
+    dev_t       device;
+    ino_t       inode;
+    haddr_t     eoa;
+    haddr_t     eof;
+    haddr_t     physical_eof;       // Beyond eof after padded direct writes
+    bool        direct;
+    size_t      alignment;
+    char        *bounce;            // Aligned
+    size_t      bounce_size;
+    IOMonitor   *monitor;
+};
+
+static const size_t _BOUNCE_BUFFER_SIZE = 4*1024*1024;
+
+// Preferred I/O size of the file system holding fname (which need not
+// exist yet)
+static size_t
+_file_system_block_size(const char *fname)
+{
+    struct stat st;
+    std::string path(fname);
+
+    if (stat(path.c_str(), &st) < 0)
+    {
+        size_t slash = path.rfind('/');
+        path = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+        if (stat(path.c_str(), &st) < 0)
+            return 4096;
+    }
+
+    size_t size = st.st_blksize;
+
+    // O_DIRECT needs at least the logical sector size, a power of 2
+    if (size < 512 || (size & (size - 1)) != 0)
+        size = 4096;
+
+    return size;
+}
+
+// Reads past the end of the file return zeros
+static bool
+_pread_all(int fd, char *buffer, size_t size, off_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t n = pread(fd, buffer, size, offset);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return false;
+        if (n == 0)
+        {
+            memset(buffer, 0, size);
+            return true;
+        }
+
+        buffer += n;
+        offset += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool
+_pwrite_all(int fd, const char *buffer, size_t size, off_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t n = pwrite(fd, buffer, size, offset);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        buffer += n;
+        offset += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool
+_posix_transfer(_PosixFile *file, bool writing, haddr_t addr, size_t size, char *buffer)
+{
+    if (!file->direct)
+        return writing ? _pwrite_all(file->fd, buffer, size, addr) : _pread_all(file->fd, buffer, size, addr);
+
+    const size_t a = file->alignment;
+
+    while (size > 0)
+    {
+        if (addr % a == 0 && (uintptr_t)buffer % a == 0 && size >= a)
+        {
+            // Aligned, directly from/to the buffer
+            const size_t n = size - size % a;
+
+            if (writing ? !_pwrite_all(file->fd, buffer, n, addr) : !_pread_all(file->fd, buffer, n, addr))
+                return false;
+
+            if (writing)
+                file->physical_eof = std::max(file->physical_eof, (haddr_t)(addr + n));
+
+            addr += n;
+            buffer += n;
+            size -= n;
+            continue;
+        }
+
+        // Through the bounce buffer, covering whole blocks
+        if (file->bounce == NULL)
+        {
+            file->bounce_size = std::max(_BOUNCE_BUFFER_SIZE - _BOUNCE_BUFFER_SIZE % a, a);
+
+            void *p;
+            if (posix_memalign(&p, a, file->bounce_size) != 0)
+                return false;
+            file->bounce = (char*)p;
+        }
+
+        const haddr_t   start = addr - addr % a;
+        const size_t    skip = addr - start;
+        const size_t    n = std::min(size, file->bounce_size - skip);
+        const size_t    blocks = (skip + n + a - 1) / a * a;
+
+        // Writes of partial blocks need their other bytes
+        if (!writing || skip > 0 || n % a != 0)
+        {
+            if (!_pread_all(file->fd, file->bounce, blocks, start))
+                return false;
+        }
+
+        if (writing)
+        {
+            memcpy(file->bounce + skip, buffer, n);
+            if (!_pwrite_all(file->fd, file->bounce, blocks, start))
+                return false;
+            file->physical_eof = std::max(file->physical_eof, (haddr_t)(start + blocks));
+        }
+        else
+            memcpy(buffer, file->bounce + skip, n);
+
+        addr += n;
+        buffer += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static H5FD_t *
+_posix_open(const char *name, unsigned flags, hid_t fapl_id, haddr_t maxaddr)
+{
+    const _PosixDriverConfig *config = (const _PosixDriverConfig*)H5Pget_driver_info(fapl_id);
+
+    (void)maxaddr;
+
+    int o = (flags & H5F_ACC_RDWR) ? O_RDWR : O_RDONLY;
+    if (flags & H5F_ACC_CREAT)
+        o |= O_CREAT;
+    if (flags & H5F_ACC_TRUNC)
+        o |= O_TRUNC;
+    if (flags & H5F_ACC_EXCL)
+        o |= O_EXCL;
+
+    int fd = open(name, o, 0666);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    _PosixFile *file = new _PosixFile;
+
+    memset(&file->pub, 0, sizeof(file->pub));
+    file->fd = fd;
+    file->device = st.st_dev;
+    file->inode = st.st_ino;
+    file->eoa = 0;
+    file->eof = file->physical_eof = st.st_size;
+    file->direct = false;
+    file->alignment = config != NULL && config->alignment > 0 ? config->alignment : 4096;
+    file->bounce = NULL;
+    file->bounce_size = 0;
+    file->monitor = config != NULL ? config->monitor : NULL;
+
+#ifdef O_DIRECT
+    if (config != NULL && config->direct)
+        file->direct = fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) == 0;
+#endif
+
+    return &file->pub;
+}
+
+static herr_t
+_posix_close(H5FD_t *_file)
+{
+    _PosixFile  *file = (_PosixFile*)_file;
+    int         status = close(file->fd);
+
+    free(file->bounce);
+    delete file;
+
+    return status < 0 ? -1 : 0;
+}
+
+static int
+_posix_cmp(const H5FD_t *_f1, const H5FD_t *_f2)
+{
+    const _PosixFile *f1 = (const _PosixFile*)_f1;
+    const _PosixFile *f2 = (const _PosixFile*)_f2;
+
+    if (f1->device != f2->device)
+        return f1->device < f2->device ? -1 : 1;
+    if (f1->inode != f2->inode)
+        return f1->inode < f2->inode ? -1 : 1;
+
+    return 0;
+}
+
+static herr_t
+_posix_query(const H5FD_t *file, unsigned long *flags)
+{
+    (void)file;
+
+    *flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE |
+        H5FD_FEAT_AGGREGATE_SMALLDATA | H5FD_FEAT_POSIX_COMPAT_HANDLE;
+
+    return 0;
+}
+
+static haddr_t
+_posix_get_eoa(const H5FD_t *file, H5FD_mem_t type)
+{
+    (void)type;
+
+    return ((const _PosixFile*)file)->eoa;
+}
+
+static herr_t
+_posix_set_eoa(H5FD_t *file, H5FD_mem_t type, haddr_t addr)
+{
+    (void)type;
+
+    ((_PosixFile*)file)->eoa = addr;
+
+    return 0;
+}
+
+static haddr_t
+_posix_get_eof(const H5FD_t *file, H5FD_mem_t type)
+{
+    (void)type;
+
+    return ((const _PosixFile*)file)->eof;
+}
+
+static herr_t
+_posix_get_handle(H5FD_t *file, hid_t fapl_id, void **handle)
+{
+    (void)fapl_id;
+
+    *handle = &((_PosixFile*)file)->fd;
+
+    return 0;
+}
+
+static void
+_posix_monitor(IOMonitor *monitor, bool write, haddr_t addr, size_t size)
+{
+    if (write)
+    {
+        monitor->writes++;
+        monitor->bytes_written += size;
+    }
+    else
+    {
+        monitor->reads++;
+        monitor->bytes_read += size;
+    }
+
+    if (monitor->log)
+    {
+        IOOperation operation;
+
+        operation.write = write;
+        operation.offset = addr;
+        operation.size = size;
+
+        monitor->operations.push_back(operation);
+    }
+
+    double delay = monitor->latency;
+    if (monitor->bandwidth > 0.0)
+        delay += size / monitor->bandwidth;
+
+    if (delay > 0.0)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+        monitor->delay += delay;
+    }
+}
+
+static herr_t
+_posix_read(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr, size_t size, void *buffer)
+{
+    _PosixFile *file = (_PosixFile*)_file;
+
+    (void)type;
+    (void)dxpl_id;
+
+    if (file->monitor != NULL)
+        _posix_monitor(file->monitor, false, addr, size);
+
+    return _posix_transfer(file, false, addr, size, (char*)buffer) ? 0 : -1;
+}
+
+static herr_t
+_posix_write(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr, size_t size, const void *buffer)
+{
+    _PosixFile *file = (_PosixFile*)_file;
+
+    (void)type;
+    (void)dxpl_id;
+
+    if (file->monitor != NULL)
+        _posix_monitor(file->monitor, true, addr, size);
+
+    if (!_posix_transfer(file, true, addr, size, (char*)buffer))
+        return -1;
+
+    file->eof = std::max(file->eof, (haddr_t)(addr + size));
+    file->physical_eof = std::max(file->physical_eof, file->eof);
+
+    return 0;
+}
+
+static herr_t
+_posix_truncate(H5FD_t *_file, hid_t dxpl_id, hbool_t closing)
+{
+    _PosixFile *file = (_PosixFile*)_file;
+
+    (void)dxpl_id;
+    (void)closing;
+
+    // Also drops the padding of direct writes
+    if (file->physical_eof != file->eoa)
+    {
+        if (ftruncate(file->fd, file->eoa) < 0)
+            return -1;
+        file->eof = file->physical_eof = file->eoa;
+    }
+
+    return 0;
+}
+
+static hid_t
+_posix_driver_id()
+{
+    static hid_t driver_id = -1;
+
+    if (driver_id >= 0 && H5Iis_valid(driver_id) > 0)
+        return driver_id;
+
+    H5FD_class_t    cls;
+    memset(&cls, 0, sizeof(cls));
+
+#if H5_VERSION_GE(1,14,0)
+    cls.version = H5FD_CLASS_VERSION;
+    cls.value = (H5FD_class_value_t)601;
+#endif
+    cls.name = "uhdf5_posix";
+    cls.maxaddr = ((haddr_t)1 << (8 * sizeof(off_t) - 1)) - 1;
+    cls.fc_degree = H5F_CLOSE_WEAK;
+    cls.fapl_size = sizeof(_PosixDriverConfig);
+    cls.open = _posix_open;
+    cls.close = _posix_close;
+    cls.cmp = _posix_cmp;
+    cls.query = _posix_query;
+    cls.get_eoa = _posix_get_eoa;
+    cls.set_eoa = _posix_set_eoa;
+    cls.get_eof = _posix_get_eof;
+    cls.get_handle = _posix_get_handle;
+    cls.read = _posix_read;
+    cls.write = _posix_write;
+    cls.truncate = _posix_truncate;
+
+    const H5FD_mem_t fl_map[H5FD_MEM_NTYPES] = H5FD_FLMAP_DICHOTOMY;
+    memcpy(cls.fl_map, fl_map, sizeof(cls.fl_map));
+
+    driver_id = H5FDregister(&cls);
+
+    return driver_id;
+}
+
+//
+// File
+//
+
+File::File():
+    FileAndGroupParent()
+{
+}
+
+File::~File()
+{
+    close();
+}
+
+FileOptions::FileOptions()
+{
+    swmr = false;
+    latest_format = false;
+    direct_io = false;
+    io_monitor = NULL;
+#ifdef H5_HAVE_PARALLEL
+    mpi_comm = MPI_COMM_NULL;
+    mpi_info = MPI_INFO_NULL;
+#endif
+}
+
+hid_t
+File::_create_access_plist(const char *fname, const FileOptions& options)
+{
+    hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+
+    if (options.swmr || options.latest_format)
+        H5Pset_libver_bounds(plist_id, H5F_LIBVER_LATEST, H5F_LIBVER_LATEST);
+
+    if (options.direct_io || options.io_monitor != NULL)
+    {
+        const size_t alignment = _file_system_block_size(fname);
+
+#ifdef H5_HAVE_DIRECT
+        if (options.io_monitor == NULL)
+            H5Pset_fapl_direct(plist_id, alignment, alignment, 4*1024*1024);
+        else
+#endif
+        {
+            _PosixDriverConfig  config;
+
+            config.direct = options.direct_io;
+            config.alignment = alignment;
+            config.monitor = options.io_monitor;
+
+            H5Pset_driver(plist_id, _posix_driver_id(), &config);
+        }
+
+        if (options.direct_io)
+            H5Pset_alignment(plist_id, 64*1024, alignment);
+    }
+
+#ifdef H5_HAVE_PARALLEL
+    if (options.mpi_comm != MPI_COMM_NULL)
+    {
+        H5Pset_fapl_mpio(plist_id, options.mpi_comm, options.mpi_info);
+
+        // Metadata gets read by one process and broadcast, instead of
+        // all processes hitting the file system for the same bytes
+        H5Pset_all_coll_metadata_ops(plist_id, true);
+        H5Pset_coll_metadata_write(plist_id, true);
+    }
+#endif
+
+    return plist_id;
+}
+
+#ifdef H5_HAVE_PARALLEL
+bool
+File::open(const char *fname, MPI_Comm comm, bool readonly, MPI_Info info)
+{
+    FileOptions options;
+
+    options.mpi_comm = comm;
+    options.mpi_info = info;
+
+    return open(fname, readonly, options);
+}
+
+bool
+File::create(const char *fname, MPI_Comm comm, bool overwrite, MPI_Info info)
+{
+    FileOptions options;
+
+    options.mpi_comm = comm;
+    options.mpi_info = info;
+
+    return create(fname, overwrite, options);
+}
+#endif
+
+bool
+File::open(const char *fname, bool readonly)
+{
+    return open(fname, readonly, FileOptions());
+}
+
+bool
+File::open(const char *fname, bool readonly, const FileOptions& options)
+{
+    unsigned int flags;
+
+    if (readonly)
+        flags = H5F_ACC_RDONLY;
+    else
+        flags = H5F_ACC_RDWR;
+
+    if (options.swmr)
+        flags |= readonly ? H5F_ACC_SWMR_READ : H5F_ACC_SWMR_WRITE;
+
+    hid_t plist_id = _create_access_plist(fname, options);
+
+    m_id = H5Fopen(fname, flags, plist_id);
+
+    H5Pclose(plist_id);
+
+    if (m_id < 0)
+        return false;
+
+    m_missing_paths = std::make_shared<std::set<std::string> >();
+
+    return true;
+}
+
+bool
+File::create(const char *fname, bool overwrite)
+{
+    return create(fname, overwrite, FileOptions());
+}
+
+bool
+File::create(const char *fname, bool overwrite, const FileOptions& options)
+{
+    /*
+    The flags parameter specifies whether an existing file is to be overwritten.
+    It should be set to either H5F_ACC_TRUNC to overwrite an existing file or H5F_ACC_EXCL,
+    instructing the function to fail if the file already exists.
+
+    From http://www.hdfgroup.org/HDF5/doc/RM/RM_H5F.html:
+
+    New files are always created in read-write mode, so the read-write and read-only flags,
+    H5F_ACC_RDWR and H5F_ACC_RDONLY, respectively, are not relevant in this function.
+    Further note that a specification of H5F_ACC_RDONLY will be ignored; the file will
+    be created in read-write mode, regardless.
+    */
+
+    unsigned int flags;
+
+    if (overwrite)
+        flags = H5F_ACC_TRUNC;
+    else
+        flags = H5F_ACC_EXCL;
+
+    hid_t plist_id = _create_access_plist(fname, options);
+
+    m_id = H5Fcreate(fname, flags, H5P_DEFAULT, plist_id);
+
+    H5Pclose(plist_id);
+
+    if (m_id < 0)
+        return false;
+
+    m_missing_paths = std::make_shared<std::set<std::string> >();
+
+    return true;
+}
+
+bool
+File::start_swmr_write()
+{
+    return H5Fstart_swmr_write(m_id) >= 0;
+}
+
+void
+File::close()
+{
+    if (m_id == -1)
+        return;
+
+    H5Fclose(m_id);
+    m_id = -1;
+    m_name.clear();
+    m_missing_paths.reset();
+}
+
+//
+// Group
+//
+
+Group::Group():
+    FileAndGroupParent()
+{
+}
+
+Group::Group(hid_t group_id):
+    FileAndGroupParent(group_id)
+{
+}
+
+Group::Group(Group&& other):
+    FileAndGroupParent(other.m_id)
+{
+    m_name = std::move(other.m_name);
+    m_missing_paths = std::move(other.m_missing_paths);
+    other.m_id = -1;
+}
+
+Group::~Group()
+{
+    close();
+}
+
+Group&
+Group::operator=(Group&& other)
+{
+    if (this != &other)
+    {
+        close();
+        m_id = other.m_id;
+        m_name = std::move(other.m_name);
+        m_missing_paths = std::move(other.m_missing_paths);
+        other.m_id = -1;
+    }
+
+    return *this;
+}
+
+void
+Group::close()
+{
+    if (m_id == -1)
+        return;
+
+    H5Gclose(m_id);
+    m_id = -1;
+    m_name.clear();
+    m_missing_paths.reset();
+}
+
+//
+// StringTable
+//
+
+StringTable::StringTable()
+{
+    m_block_size = m_block_used = 0;
+}
+
+StringTable::StringTable(StringTable&& other):
+    m_blocks(std::move(other.m_blocks)), m_strings(std::move(other.m_strings)), m_lengths(std::move(other.m_lengths))
+{
+    m_block_size = other.m_block_size;
+    m_block_used = other.m_block_used;
+    other.clear();
+}
+
+StringTable&
+StringTable::operator=(StringTable&& other)
+{
+    if (this != &other)
+    {
+        m_blocks = std::move(other.m_blocks);
+        m_block_size = other.m_block_size;
+        m_block_used = other.m_block_used;
+        m_strings = std::move(other.m_strings);
+        m_lengths = std::move(other.m_lengths);
+        other.clear();
+    }
+
+    return *this;
+}
+
+void
+StringTable::clear()
+{
+    m_blocks.clear();
+    m_block_size = m_block_used = 0;
+    m_strings.clear();
+    m_lengths.clear();
+}
+
+char *
+StringTable::_allocate(size_t size)
+{
+    size = std::max(size, (size_t)1);
+
+    if (m_blocks.empty() || m_block_used + size > m_block_size)
+    {
+        // Growing blocks, so the number of allocations stays small. Not
+        // zeroed, as every string gets written
+        m_block_size = std::max(size, m_blocks.empty() ? 64*1024 : std::min(2*m_block_size, (size_t)64*1024*1024));
+        m_blocks.push_back(std::unique_ptr<char[]>(new char[m_block_size]));
+        m_block_used = 0;
+    }
+
+    char *p = &m_blocks.back()[m_block_used];
+    m_block_used += size;
+
+    return p;
+}
+
+void *
+StringTable::_vlen_allocate(size_t size, void *info)
+{
+    return ((StringTable*)info)->_allocate(size);
+}
+
+void
+StringTable::_vlen_free(void *mem, void *info)
+{
+    // Freed with the whole table
+    (void)mem;
+    (void)info;
+}
+
+bool
+StringTable::_read(hid_t object_id, bool is_dataset, hid_t xfer_plist)
+{
+    clear();
+
+    hid_t   type_id = is_dataset ? H5Dget_type(object_id) : H5Aget_type(object_id);
+
+    if (H5Tget_class(type_id) != H5T_STRING)
+    {
+        fprintf(stderr, "Not a string %s!\n", is_dataset ? "dataset" : "attribute");
+        H5Tclose(type_id);
+        return false;
+    }
+
+    hid_t   space_id = is_dataset ? H5Dget_space(object_id) : H5Aget_space(object_id);
+    size_t  count = H5Sget_simple_extent_npoints(space_id);
+    hid_t   memtype = H5Tcopy(H5T_C_S1);
+    herr_t  status = 0;
+
+    H5Tset_cset(memtype, H5Tget_cset(type_id));
+
+    m_strings.resize(count);
+    m_lengths.resize(count);
+
+    if (count == 0)
+        ;
+    else if (H5Tis_variable_str(type_id) > 0)
+    {
+        H5Tset_size(memtype, H5T_VARIABLE);
+
+        if (is_dataset)
+        {
+            // HDF5 allocates each string separately, so have it use the blocks
+            hid_t   plist_id = xfer_plist == H5P_DEFAULT ? H5Pcreate(H5P_DATASET_XFER) : H5Pcopy(xfer_plist);
+
+            H5Pset_vlen_mem_manager(plist_id, _vlen_allocate, this, _vlen_free, this);
+            status = H5Dread(object_id, memtype, H5S_ALL, H5S_ALL, plist_id, &m_strings[0]);
+            H5Pclose(plist_id);
+        }
+        else
+        {
+            // Attribute reads take no memory manager, so copy (which for
+            // attributes is cheap) and reclaim
+            std::vector<char*>  strings(count);
+
+            status = H5Aread(object_id, memtype, &strings[0]);
+            if (status >= 0)
+            {
+                size_t total = 0;
+                for (size_t i = 0; i < count; i++)
+                    total += strings[i] != NULL ? strlen(strings[i]) + 1 : 0;
+
+                char *p = _allocate(total);
+                for (size_t i = 0; i < count; i++)
+                {
+                    if (strings[i] == NULL)
+                        continue;
+                    strcpy(p, strings[i]);
+                    m_strings[i] = p;
+                    p += strlen(p) + 1;
+                }
+
+#if H5_VERSION_GE(1,12,0)
+                H5Treclaim(memtype, space_id, H5P_DEFAULT, &strings[0]);
+#else
+                H5Dvlen_reclaim(memtype, space_id, H5P_DEFAULT, &strings[0]);
+#endif
+            }
+        }
+
+        for (size_t i = 0; status >= 0 && i < count; i++)
+        {
+            // Unwritten elements
+            if (m_strings[i] == NULL)
+                m_strings[i] = "";
+            m_lengths[i] = strlen(m_strings[i]);
+        }
+    }
+    else
+    {
+        // One more byte per string, so HDF5 NUL-terminates all of them
+        // (and strips any padding)
+        const size_t size = H5Tget_size(type_id) + 1;
+
+        H5Tset_size(memtype, size);
+        H5Tset_strpad(memtype, H5T_STR_NULLTERM);
+
+        char *p = _allocate(count * size);
+
+        if (is_dataset)
+            status = H5Dread(object_id, memtype, H5S_ALL, H5S_ALL, xfer_plist, p);
+        else
+            status = H5Aread(object_id, memtype, p);
+
+        for (size_t i = 0; status >= 0 && i < count; i++, p += size)
+        {
+            m_strings[i] = p;
+            m_lengths[i] = strlen(p);
+        }
+    }
+
+    H5Tclose(memtype);
+    H5Sclose(space_id);
+    H5Tclose(type_id);
+
+    if (status < 0)
+    {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// ReadBuffer
+//
+
+const size_t _HUGE_PAGE_SIZE = 2*1024*1024;
+
+static size_t
+_page_size()
+{
+    static const long size = sysconf(_SC_PAGESIZE);
+
+    return size > 0 ? size : 4096;
+}
+
+template <typename T>
+ReadBuffer<T>::ReadBuffer(size_t alignment, bool huge_pages, int first_touch_threads)
+{
+    m_data = NULL;
+    m_size = m_capacity = 0;
+    m_alignment = std::max(alignment, sizeof(void*));
+    m_huge_pages = huge_pages;
+    m_first_touch_threads = first_touch_threads;
+    m_allocations = 0;
+
+    // As posix_memalign() needs. Every reserve() fails then
+    if ((alignment & (alignment - 1)) != 0)
+    {
+        fprintf(stderr, "Read buffer alignment %zu is not a power of 2!\n", alignment);
+        m_alignment = 0;
+        return;
+    }
+
+    if (huge_pages)
+        m_alignment = std::max(m_alignment, _HUGE_PAGE_SIZE);
+}
+
+template <typename T>
+ReadBuffer<T>::ReadBuffer(ReadBuffer&& other):
+    m_dims(std::move(other.m_dims))
+{
+    m_data = other.m_data;
+    m_size = other.m_size;
+    m_capacity = other.m_capacity;
+    m_alignment = other.m_alignment;
+    m_huge_pages = other.m_huge_pages;
+    m_first_touch_threads = other.m_first_touch_threads;
+    m_allocations = other.m_allocations;
+    other.m_data = NULL;
+    other.m_size = other.m_capacity = 0;
+}
+
+template <typename T>
+ReadBuffer<T>::~ReadBuffer()
+{
+    release();
+}
+
+template <typename T>
+ReadBuffer<T>&
+ReadBuffer<T>::operator=(ReadBuffer&& other)
+{
+    if (this != &other)
+    {
+        release();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        m_dims = std::move(other.m_dims);
+        m_alignment = other.m_alignment;
+        m_huge_pages = other.m_huge_pages;
+        m_first_touch_threads = other.m_first_touch_threads;
+        m_allocations = other.m_allocations;
+        other.m_data = NULL;
+        other.m_size = other.m_capacity = 0;
+    }
+
+    return *this;
+}
+
+template <typename T>
+bool
+ReadBuffer<T>::reserve(size_t size)
+{
+    if (size <= m_capacity)
+        return true;
+
+    if (m_alignment == 0)
+        return false;
+
+    // Whole huge pages, otherwise whole alignment units
+    const size_t    unit = m_huge_pages ? _HUGE_PAGE_SIZE : m_alignment;
+    const size_t    bytes = (size * sizeof(T) + unit - 1) / unit * unit;
+    void            *p;
+
+    // Allocated before the old memory is freed, which is kept if failed
+    if (size > (SIZE_MAX - unit) / sizeof(T) || posix_memalign(&p, m_alignment, bytes) != 0)
+    {
+        fprintf(stderr, "Failed to allocate %zu elements for read buffer!\n", size);
+        return false;
+    }
+
+    release();
+
+#ifdef MADV_HUGEPAGE
+    if (m_huge_pages)
+        madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+
+    if (m_first_touch_threads > 1)
+    {
+        const size_t    parts = m_first_touch_threads;
+        const size_t    page = m_huge_pages ? _HUGE_PAGE_SIZE : _page_size();
+        char            *q = static_cast<char*>(p);
+
+        _parallel_for(parts, parts, [=](size_t i)
+        {
+            // Split on page boundaries, as the first thread to touch a
+            // page decides its node
+            const size_t first = bytes * i / parts / page * page;
+            const size_t last = i + 1 == parts ? bytes : bytes * (i + 1) / parts / page * page;
+
+            memset(q + first, 0, last - first);
+        });
+    }
+
+    m_data = static_cast<T*>(p);
+    m_capacity = bytes / sizeof(T);
+    m_allocations++;
+
+    return true;
+}
+
+template <typename T>
+void
+ReadBuffer<T>::release()
+{
+    free(m_data);
+    m_data = NULL;
+    m_size = m_capacity = 0;
+    m_dims.clear();
+}
+
+template <typename T>
+bool
+ReadBuffer<T>::_resize(const dimensions& dims)
+{
+    size_t size = 1;
+    for (size_t i = 0; i < dims.size(); i++)
+        size *= dims[i];
+
+    // Keep the current size and dimensions if failed
+    if (!reserve(std::max<size_t>(size, 1)))
+        return false;
+
+    m_size = size;
+    m_dims = dims;
+
+    return true;
+}
+
+// Write strings to a string dataset or attribute
+static bool
+_write_strings(hid_t object_id, bool is_dataset, const std::vector<std::string>& strings, hid_t xfer_plist)
+{
+    hid_t   type_id = is_dataset ? H5Dget_type(object_id) : H5Aget_type(object_id);
+    hid_t   space_id = is_dataset ? H5Dget_space(object_id) : H5Aget_space(object_id);
+    size_t  count = H5Sget_simple_extent_npoints(space_id);
+    bool    ok = true;
+
+    H5Sclose(space_id);
+
+    if (H5Tget_class(type_id) != H5T_STRING)
+    {
+        fprintf(stderr, "Not a string %s!\n", is_dataset ? "dataset" : "attribute");
+        ok = false;
+    }
+    else if (strings.size() != count)
+    {
+        fprintf(stderr, "Got %zu strings for %zu elements!\n", strings.size(), count);
+        ok = false;
+    }
+
+    if (!ok || count == 0)
+    {
+        H5Tclose(type_id);
+        return ok;
+    }
+
+    hid_t   memtype = H5Tcopy(type_id);
+    herr_t  status;
+
+    if (H5Tis_variable_str(type_id) > 0)
+    {
+        std::vector<const char*>    pointers(count);
+
+        for (size_t i = 0; i < count; i++)
+            pointers[i] = strings[i].c_str();
+
+        if (is_dataset)
+            status = H5Dwrite(object_id, memtype, H5S_ALL, H5S_ALL, xfer_plist, &pointers[0]);
+        else
+            status = H5Awrite(object_id, memtype, &pointers[0]);
+    }
+    else
+    {
+        // Packed, padded with NULs. Types made elsewhere may need room for
+        // the terminating NUL
+        const size_t        size = H5Tget_size(type_id);
+        const size_t        max_length = H5Tget_strpad(type_id) == H5T_STR_NULLTERM ? size - 1 : size;
+        std::vector<char>   buffer(count * size, 0);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (strings[i].size() > max_length)
+            {
+                fprintf(stderr, "String of %zu bytes doesn't fit in %zu!\n", strings[i].size(), max_length);
+                H5Tclose(memtype);
+                H5Tclose(type_id);
+                return false;
+            }
+
+            memcpy(&buffer[i * size], strings[i].data(), strings[i].size());
+        }
+
+        if (is_dataset)
+            status = H5Dwrite(object_id, memtype, H5S_ALL, H5S_ALL, xfer_plist, &buffer[0]);
+        else
+            status = H5Awrite(object_id, memtype, &buffer[0]);
+    }
+
+    H5Tclose(memtype);
+    H5Tclose(type_id);
+
+    return status >= 0;
+}
+
+//
+// Dataset
+//
+
+Dataset::Dataset()
+{
+    m_dataset_id = -1;
+    m_transfer_plist = H5P_DEFAULT;
+    m_mpio = m_collective = false;
+#ifdef H5_HAVE_PARALLEL
+    m_comm = MPI_COMM_NULL;
+#endif
+}
+
+Dataset::Dataset(hid_t dset_id, const dimensions& dims)
+{
+    m_dataset_id = dset_id;
+    
+    m_dimensions = dims;
+
+    m_transfer_plist = H5P_DEFAULT;
+    m_mpio = m_collective = false;
+#ifdef H5_HAVE_PARALLEL
+    m_comm = MPI_COMM_NULL;
+#endif
+
+    _load_metadata();
+}
+
+Dataset::Dataset(Dataset&& other):
+    m_dimensions(std::move(other.m_dimensions)), m_metadata(std::move(other.m_metadata)),
+    m_probe_blocks(std::move(other.m_probe_blocks))
+{
+    m_dataset_id = other.m_dataset_id;
+    m_transfer_plist = other.m_transfer_plist;
+    m_mpio = other.m_mpio;
+    m_collective = other.m_collective;
+    other.m_dataset_id = -1;
+    other.m_transfer_plist = H5P_DEFAULT;
+#ifdef H5_HAVE_PARALLEL
+    m_comm = other.m_comm;
+    other.m_comm = MPI_COMM_NULL;
+#endif
+}
+
+Dataset::~Dataset()
+{
+    close();
+}
+
+Dataset&
+Dataset::operator=(Dataset&& other)
+{
+    if (this != &other)
+    {
+        close();
+        m_dataset_id = other.m_dataset_id;
+        m_dimensions = std::move(other.m_dimensions);
+        m_metadata = std::move(other.m_metadata);
+        m_probe_blocks = std::move(other.m_probe_blocks);
+        m_transfer_plist = other.m_transfer_plist;
+        m_mpio = other.m_mpio;
+        m_collective = other.m_collective;
+        other.m_dataset_id = -1;
+        other.m_transfer_plist = H5P_DEFAULT;
+#ifdef H5_HAVE_PARALLEL
+        m_comm = other.m_comm;
+        other.m_comm = MPI_COMM_NULL;
+#endif
+    }
+
+    return *this;
+}
+
+void
+Dataset::close()
+{
+    m_probe_blocks.clear();
+
+    if (m_transfer_plist != H5P_DEFAULT)
+    {
+        H5Pclose(m_transfer_plist);
+        m_transfer_plist = H5P_DEFAULT;
+    }
+
+#ifdef H5_HAVE_PARALLEL
+    if (m_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&m_comm);
+#endif
+
+    if (m_dataset_id < 0)
+        return;
+
+    H5Dclose(m_dataset_id);
+    m_dataset_id = -1;
+    m_metadata = DatasetMetadata();
+}
+
+void
+Dataset::set_collective(bool collective)
+{
+#ifdef H5_HAVE_PARALLEL
+    if (!m_mpio)
+        return;
+
+    if (m_transfer_plist == H5P_DEFAULT)
+        m_transfer_plist = H5Pcreate(H5P_DATASET_XFER);
+
+    H5Pset_dxpl_mpio(m_transfer_plist, collective ? H5FD_MPIO_COLLECTIVE : H5FD_MPIO_INDEPENDENT);
+
+    m_collective = collective;
+#else
+    (void)collective;
+#endif
+}
+
+long long
+Dataset::_num_transfers(long long num_transfers, bool may_differ) const
+{
+    if (!m_collective)
+        return num_transfers;
+
+    long long result = std::max(num_transfers, 1LL);
+
+#ifdef H5_HAVE_PARALLEL
+    if (may_differ && m_comm != MPI_COMM_NULL)
+        MPI_Allreduce(&num_transfers, &result, 1, MPI_LONG_LONG, MPI_MAX, m_comm);
+#else
+    (void)may_differ;
+#endif
+
+    return result;
+}
+
+bool
+Dataset::_transfer_none(bool writing, hid_t memtype)
+{
+    // Nothing to transfer, but a collective transfer needs all processes
+    if (!m_collective)
+        return true;
+
+    hid_t   file_space_id = H5Dget_space(m_dataset_id);
+    hid_t   mem_space_id = H5Scopy(file_space_id);
+    herr_t  status;
+
+    H5Sselect_none(file_space_id);
+    H5Sselect_none(mem_space_id);
+
+    if (writing)
+        status = H5Dwrite(m_dataset_id, memtype, mem_space_id, file_space_id, m_transfer_plist, NULL);
+    else
+        status = H5Dread(m_dataset_id, memtype, mem_space_id, file_space_id, m_transfer_plist, NULL);
+
+    H5Sclose(mem_space_id);
+    H5Sclose(file_space_id);
+
+    return status >= 0;
+}
+
+void
+Dataset::_load_metadata()
+{
+    const int N = m_dimensions.size();
+
+    // Type
+
+    Type    type(H5Dget_type(m_dataset_id));
+
+    m_metadata.type_class = type.get_class();
+    m_metadata.is_signed = m_metadata.type_class == Type::INTEGER && type.is_signed();
+    m_metadata.element_size = type.get_size();
+
+    hid_t native_type_id = H5Tget_native_type(type.get_id(), H5T_DIR_ASCEND);
+    m_metadata.native_element_size = native_type_id >= 0 ? H5Tget_size(native_type_id) : m_metadata.element_size;
+    if (native_type_id >= 0)
+        H5Tclose(native_type_id);
+
+    // Maximum dimensions
+
+    hid_t   dataspace_id = H5Dget_space(m_dataset_id);
+    hsize_t d[N], maxd[N];
+
+    H5Sget_simple_extent_dims(dataspace_id, d, maxd);
+    H5Sclose(dataspace_id);
+
+    m_metadata.max_dims.clear();
+    for (int i = 0; i < N; i++)
+        m_metadata.max_dims.push_back(maxd[i] == H5S_UNLIMITED ? UNLIMITED : (int)maxd[i]);
+
+    // Layout and filters
+
+    hid_t   plist_id = H5Dget_create_plist(m_dataset_id);
+
+    switch (H5Pget_layout(plist_id))
+    {
+    case H5D_COMPACT:
+        m_metadata.layout = DatasetMetadata::LAYOUT_COMPACT;
+        break;
+    case H5D_CHUNKED:
+        m_metadata.layout = DatasetMetadata::LAYOUT_CHUNKED;
+        break;
+    case H5D_VIRTUAL:
+        m_metadata.layout = DatasetMetadata::LAYOUT_VIRTUAL;
+        break;
+    default:
+        m_metadata.layout = DatasetMetadata::LAYOUT_CONTIGUOUS;
+    }
+
+    m_metadata.chunk_dims.clear();
+    if (m_metadata.layout == DatasetMetadata::LAYOUT_CHUNKED)
+    {
+        hsize_t c[N];
+        H5Pget_chunk(plist_id, N, c);
+        for (int i = 0; i < N; i++)
+            m_metadata.chunk_dims.push_back(c[i]);
+    }
+
+    m_metadata.filters.clear();
+    const int num_filters = H5Pget_nfilters(plist_id);
+    for (int i = 0; i < num_filters; i++)
+    {
+        unsigned    flags, filter_config;
+        size_t      cd_nelmts = 0;
+
+        m_metadata.filters.push_back(H5Pget_filter2(plist_id, i, &flags, &cd_nelmts, NULL, 0, NULL, &filter_config));
+    }
+
+    m_metadata.external = H5Pget_external_count(plist_id) > 0;
+
+    H5Pclose(plist_id);
+
+    m_metadata.storage_size = H5Dget_storage_size(m_dataset_id);
+
+#ifdef H5_HAVE_PARALLEL
+    // Collective transfers by default for files opened with MPI-IO
+
+    hid_t   file_id = H5Iget_file_id(m_dataset_id);
+    hid_t   fapl_id = H5Fget_access_plist(file_id);
+
+    m_mpio = H5Pget_driver(fapl_id) == H5FD_MPIO;
+
+    // For padding collective transfers, see _num_transfers(). Duplicating
+    // is collective, as opening the dataset is
+    if (m_mpio && m_comm == MPI_COMM_NULL)
+    {
+        MPI_Info info = MPI_INFO_NULL;
+
+        if (H5Pget_fapl_mpio(fapl_id, &m_comm, &info) < 0)
+            m_comm = MPI_COMM_NULL;
+        else if (info != MPI_INFO_NULL)
+            MPI_Info_free(&info);
+    }
+
+    H5Pclose(fapl_id);
+    H5Fclose(file_id);
+
+    if (m_mpio)
+        set_collective(true);
+#endif
+}
+
+bool
+Dataset::_check_numeric() const
+{
+    if (m_metadata.type_class != Type::INTEGER && m_metadata.type_class != Type::FLOAT)
+    {
+        fprintf(stderr, "Dataset doesn't hold numbers!\n");
+        return false;
+    }
+
+    return true;
+}
+
+template <typename T>
+bool
+Dataset::_check_numeric() const
+{
+    if (!_check_numeric())
+        return false;
+
+    const bool floating = std::is_floating_point<T>::value;
+
+    if ((m_metadata.type_class == Type::FLOAT) != floating ||
+        (!floating && (m_metadata.native_element_size != sizeof(T) || m_metadata.is_signed != std::is_signed<T>::value)))
+    {
+        fprintf(stderr, "Dataset type doesn't match the type of the values!\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+Dataset::is_compressed() const
+{
+    for (std::vector<H5Z_filter_t>::const_iterator it = m_metadata.filters.begin(), ie = m_metadata.filters.end(); it != ie; ++it)
+    {
+        // Anything but the byte shuffle and checksum filters
+        if (*it != H5Z_FILTER_SHUFFLE && *it != H5Z_FILTER_FLETCHER32)
+            return true;
+    }
+
+    return false;
+}
+
+int
+Dataset::get_rank() const
+{
+    return m_dimensions.size();
+}
+
+void
+Dataset::get_dimensions(dimensions& dims) const
+{
+    dims.resize(m_dimensions.size());
+    std::copy(m_dimensions.begin(), m_dimensions.end(), dims.begin());
+}
+
+bool
+Dataset::get_max_dimensions(dimensions& dims) const
+{
+    dims = m_metadata.max_dims;
+
+    return true;
+}
+
+bool
+Dataset::set_extent(const dimensions& dims)
+{
+    const int N = m_dimensions.size();
+
+    if ((int)dims.size() != N)
+        return false;
+
+    hsize_t d[N];
+    for (int i = 0; i < N; i++)
+        d[i] = dims[i];
+
+    if (H5Dset_extent(m_dataset_id, d) < 0)
+        return false;
+
+    m_dimensions = dims;
+    m_probe_blocks.clear();
+
+    return true;
+}
+
+bool
+Dataset::flush()
+{
+    return H5Dflush(m_dataset_id) >= 0;
+}
+
+bool
+Dataset::refresh()
+{
+    if (H5Drefresh(m_dataset_id) < 0)
+        return false;
+
+    hid_t   dataspace_id = H5Dget_space(m_dataset_id);
+    if (dataspace_id < 0)
+        return false;
+
+    const int N = m_dimensions.size();
+    hsize_t d[N];
+    H5Sget_simple_extent_dims(dataspace_id, d, NULL);
+
+    H5Sclose(dataspace_id);
+
+    for (int i = 0; i < N; i++)
+        m_dimensions[i] = d[i];
+
+    m_probe_blocks.clear();
+
+    return true;
+}
+
+hsize_t
+Dataset::wait_for_rows(hsize_t since, double timeout, double poll_interval)
+{
+    std::chrono::steady_clock::time_point   t0 = std::chrono::steady_clock::now();
+    std::chrono::duration<double>           elapsed;
+
+    // Scalars have no rows to wait for
+    if (m_dimensions.empty())
+    {
+        fprintf(stderr, "Waiting for rows needs at least one dimension!\n");
+        return 0;
+    }
+
+    while (true)
+    {
+        if (!refresh())
+            break;
+
+        if ((hsize_t)m_dimensions[0] > since)
+            break;
+
+        elapsed = std::chrono::steady_clock::now() - t0;
+        if (elapsed.count() >= timeout)
+            break;
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(poll_interval));
+    }
+
+    return m_dimensions[0];
+}
+
+template <typename T>
+hsize_t
+Dataset::read_new_rows(std::vector<T>& values, hsize_t since, double timeout, double poll_interval)
+{
+    // Also covers scalars, which wait_for_rows() turns away with 0 rows
+    const hsize_t rows = wait_for_rows(since, timeout, poll_interval);
+
+    if (m_dimensions.empty() || rows <= since)
+    {
+        values.clear();
+        return 0;
+    }
+
+    dimensions  offset(m_dimensions.size(), 0), count(m_dimensions);
+
+    offset[0] = since;
+    count[0] = rows - since;
+
+    size_t n = 1;
+    for (size_t i = 0; i < count.size(); i++)
+        n *= count[i];
+
+    values.resize(n);
+
+    if (!read_hyperslab<T>(&values[0], offset, count))
+    {
+        values.clear();
+        return 0;
+    }
+
+    return count[0];
+}
+
+Type*
+Dataset::get_type() const
+{
+    return new Type(H5Dget_type(m_dataset_id));
+}
+
+bool
+Dataset::get_type(Type& type) const
+{
+    hid_t   type_id = H5Dget_type(m_dataset_id);
+
+    if (type_id < 0)
+        return false;
+
+    type = Type(type_id);
+
+    return true;
+}
+
+size_t
+Dataset::get_size_in_bytes() const
+{
+    return get_size_in_elements() * m_metadata.element_size;
+}
+
+size_t
+Dataset::get_size_in_elements() const
+{
+    size_t  count = 1;
+    for (h5::dimensions::const_iterator it = m_dimensions.begin(), ie = m_dimensions.end(); it != ie; ++it)
+        count *= *it;
+    return count;
+}
+
+size_t
+Dataset::get_size_in_file_bytes() const
+{
+    return H5Dget_storage_size(m_dataset_id);
+}
+
+
+// Dataset::read
+
+template <typename T>
+bool
+Dataset::_read(T* values, hid_t memtype)
+{
+    herr_t  status;
+
+    if (!_check_numeric<T>())
+        return false;
+
+    status = H5Dread(m_dataset_id, memtype, H5S_ALL, H5S_ALL, m_transfer_plist, values);
+
+    return status >= 0;
+}
+
+template<>
+bool
+Dataset::read<float>(float *values)
+{
+    return _read<float>(values, H5T_NATIVE_FLOAT);
+}
+
+template<>
+bool
+Dataset::read<double>(double *values)
+{
+    return _read<double>(values, H5T_NATIVE_DOUBLE);
+}
+
+template<>
+bool
+Dataset::read<int8_t>(int8_t *values)
+{
+    return _read<int8_t>(values, H5T_NATIVE_INT8);
+}
+
+template<>
+bool
+Dataset::read<int16_t>(int16_t *values)
+{
+    return _read<int16_t>(values, H5T_NATIVE_INT16);
+}
+
+template<>
+bool
+Dataset::read<int32_t>(int32_t *values)
+{
+    return _read<int32_t>(values, H5T_NATIVE_INT32);
+}
+
+template<>
+bool
+Dataset::read<int64_t>(int64_t *values)
+{
+    return _read<int64_t>(values, H5T_NATIVE_INT64);
+}
+
+template<>
+bool
+Dataset::read<uint8_t>(uint8_t *values)
+{
+    return _read<uint8_t>(values, H5T_NATIVE_UINT8);
+}
+
+template<>
+bool
+Dataset::read<uint16_t>(uint16_t *values)
+{
+    return _read<uint16_t>(values, H5T_NATIVE_UINT16);
+}
+
+template<>
+bool
+Dataset::read<uint32_t>(uint32_t *values)
+{
+    return _read<uint32_t>(values, H5T_NATIVE_UINT32);
+}
+
+template<>
+bool
+Dataset::read<uint64_t>(uint64_t *values)
+{
+    return _read<uint64_t>(values, H5T_NATIVE_UINT64);
+}
+
+// Dataset::write
+
+template <typename T>
+bool
+Dataset::_write(const T* values, hid_t memtype)
+{
+    herr_t  status;
+
+    if (!_check_numeric<T>())
+        return false;
+
+    m_probe_blocks.clear();
+
+    status = H5Dwrite(m_dataset_id, memtype, H5S_ALL, H5S_ALL, m_transfer_plist, values);
+
+    return status >= 0;
+}
+
+template<>
+bool
+Dataset::write<float>(float *values)
+{
+    return _write<float>(values, H5T_NATIVE_FLOAT);
+}
+
+template<>
+bool
+Dataset::write<double>(double *values)
+{
+    return _write<double>(values, H5T_NATIVE_DOUBLE);
+}
+
+template<>
+bool
+Dataset::write<int8_t>(int8_t *values)
+{
+    return _write<int8_t>(values, H5T_NATIVE_INT8);
+}
+
+template<>
+bool
+Dataset::write<int16_t>(int16_t *values)
+{
+    return _write<int16_t>(values, H5T_NATIVE_INT16);
+}
+
+template<>
+bool
+Dataset::write<int32_t>(int32_t *values)
+{
+    return _write<int32_t>(values, H5T_NATIVE_INT32);
+}
+
+template<>
+bool
+Dataset::write<int64_t>(int64_t *values)
 {
     return _write<int64_t>(values, H5T_NATIVE_INT64);
 }
 
-template<>
+template<>
+bool
+Dataset::write<uint8_t>(uint8_t *values)
+{
+    return _write<uint8_t>(values, H5T_NATIVE_UINT8);
+}
+
+template<>
+bool
+Dataset::write<uint16_t>(uint16_t *values)
+{
+    return _write<uint16_t>(values, H5T_NATIVE_UINT16);
+}
+
+template<>
+bool
+Dataset::write<uint32_t>(uint32_t *values)
+{
+    return _write<uint32_t>(values, H5T_NATIVE_UINT32);
+}
+
+template<>
+bool
+Dataset::write<uint64_t>(uint64_t *values)
+{
+    return _write<uint64_t>(values, H5T_NATIVE_UINT64);
+}
+
+// Dataset hyperslabs and memory layouts
+
+template <typename T>
+bool
+Dataset::read(T *values, const MemoryLayout& layout)
+{
+    return _check_numeric<T>() &&
+        _transfer(false, values, native_type<T>(), dimensions(m_dimensions.size(), 0), m_dimensions, &layout);
+}
+
+template <typename T>
+bool
+Dataset::write(const T *values, const MemoryLayout& layout)
+{
+    return _check_numeric<T>() &&
+        _transfer(true, const_cast<T*>(values), native_type<T>(), dimensions(m_dimensions.size(), 0), m_dimensions, &layout);
+}
+
+template <typename T>
+bool
+Dataset::read_hyperslab(T *values, const dimensions& offset, const dimensions& count, const MemoryLayout *layout)
+{
+    return _check_numeric<T>() && _transfer(false, values, native_type<T>(), offset, count, layout);
+}
+
+template <typename T>
+bool
+Dataset::read(ReadBuffer<T>& buffer)
+{
+    return _check_numeric<T>() && buffer._resize(m_dimensions) && _read<T>(buffer.data(), native_type<T>());
+}
+
+template <typename T>
+bool
+Dataset::read_hyperslab(ReadBuffer<T>& buffer, const dimensions& offset, const dimensions& count)
+{
+    return _check_numeric<T>() && buffer._resize(count) &&
+        _transfer(false, buffer.data(), native_type<T>(), offset, count, NULL);
+}
+
+template <typename T>
+bool
+Dataset::write_hyperslab(const T *values, const dimensions& offset, const dimensions& count, const MemoryLayout *layout)
+{
+    return _check_numeric<T>() && _transfer(true, const_cast<T*>(values), native_type<T>(), offset, count, layout);
+}
+
+bool
+Dataset::_check_transfer(const dimensions& offset, const dimensions& count, const MemoryLayout *layout)
+{
+    const int N = m_dimensions.size();
+
+    if ((int)offset.size() != N || (int)count.size() != N)
+    {
+        fprintf(stderr, "Hyperslab doesn't match dataset rank!\n");
+        return false;
+    }
+
+    if (layout && (layout->extents != count || (int)layout->strides.size() != N))
+    {
+        fprintf(stderr, "Memory layout doesn't match selection!\n");
+        return false;
+    }
+
+    if (layout)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            if (layout->strides[i] == 0)
+            {
+                fprintf(stderr, "Memory layout strides must be positive!\n");
+                return false;
+            }
+        }
+    }
+
+    return _check_numeric();
+}
+
+// With a memory layout the number of transfers depends on it (see below),
+// so may differ between processes. All processes then take part in all
+// collective transfers, with empty ones where they have fewer or failed
+bool
+Dataset::_transfer(bool writing, void *values, hid_t memtype, const dimensions& offset,
+    const dimensions& count, const MemoryLayout *layout)
+{
+    const int N = m_dimensions.size();
+
+    if (!_check_transfer(offset, count, layout))
+    {
+        const long long total = _num_transfers(0, layout != NULL);
+
+        for (long long i = 0; i < total; i++)
+            _transfer_none(writing, memtype);
+
+        return false;
+    }
+
+    if (writing)
+        m_probe_blocks.clear();
+
+    hsize_t start[N], cnt[N];
+    bool    empty = false;
+    for (int i = 0; i < N; i++)
+    {
+        start[i] = offset[i];
+        cnt[i] = count[i];
+        empty = empty || cnt[i] == 0;
+    }
+
+    if (empty)
+    {
+        // Still as many (empty) collective transfers as the other processes
+        const long long total = _num_transfers(0, layout != NULL);
+        bool            ok = true;
+
+        for (long long i = 0; i < total; i++)
+            ok = _transfer_none(writing, memtype) && ok;
+
+        return ok;
+    }
+
+    // A strided layout maps onto a single memory hyperslab as long as each
+    // stride is a multiple of the next one, spanning at least its extent.
+    // The memory dataspace then has the strides as its (row-major) shape.
+    // Axes before the first one where that holds (e.g. for a transpose)
+    // are iterated here, one transfer per index.
+
+    int     k = 0;
+    hsize_t mstart[N+1], mdims[N+1], mcount[N+1];
+
+    for (int i = 0; i <= N; i++)
+        mstart[i] = 0;
+
+    if (layout)
+    {
+        for (int i = N-2; i >= 0; i--)
+        {
+            if (layout->strides[i] % layout->strides[i+1] != 0 ||
+                layout->strides[i] / layout->strides[i+1] < cnt[i+1])
+            {
+                k = i + 1;
+                break;
+            }
+        }
+
+        mdims[0] = cnt[k];
+        for (int i = k+1; i < N; i++)
+            mdims[i-k] = layout->strides[i-1] / layout->strides[i];
+        mdims[N-k] = layout->strides[N-1];
+
+        for (int i = k; i < N; i++)
+            mcount[i-k] = cnt[i];
+        mcount[N-k] = 1;
+    }
+    else
+    {
+        for (int i = 0; i < N; i++)
+            mdims[i] = mcount[i] = cnt[i];
+        mdims[N] = mcount[N] = 1;
+    }
+
+    const size_t    element_size = H5Tget_size(memtype);
+    hsize_t         index[N];
+    hid_t           file_space_id, mem_space_id;
+    herr_t          status = 0;
+    long long       num_transfers = 1, done = 0;
+
+    for (int i = 0; i < k; i++)
+    {
+        index[i] = 0;
+        cnt[i] = 1;
+        num_transfers *= count[i];
+    }
+
+    const long long total = _num_transfers(num_transfers, layout != NULL);
+
+    // Without the innermost stride axis when it is 1: HDF5 only takes its
+    // fast path (much faster for chunked datasets) when the shapes match
+    const int mem_rank = mdims[N-k] == 1 ? N-k : N-k+1;
+
+    file_space_id = H5Dget_space(m_dataset_id);
+    mem_space_id = H5Screate_simple(mem_rank, mdims, NULL);
+    H5Sselect_hyperslab(mem_space_id, H5S_SELECT_SET, mstart, NULL, mcount, NULL);
+
+    while (true)
+    {
+        hsize_t base = layout ? layout->offset : 0;
+        for (int i = 0; i < k; i++)
+        {
+            start[i] = offset[i] + index[i];
+            base += index[i] * layout->strides[i];
+        }
+
+        H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, start, NULL, cnt, NULL);
+
+        char *p = static_cast<char*>(values) + base * element_size;
+
+        if (writing)
+            status = H5Dwrite(m_dataset_id, memtype, mem_space_id, file_space_id, m_transfer_plist, p);
+        else
+            status = H5Dread(m_dataset_id, memtype, mem_space_id, file_space_id, m_transfer_plist, p);
+
+        done++;
+
+        if (status < 0)
+            break;
+
+        int d = k - 1;
+        for (; d >= 0; d--)
+        {
+            if (++index[d] < (hsize_t)count[d])
+                break;
+            index[d] = 0;
+        }
+
+        if (d < 0)
+            break;
+    }
+
+    H5Sclose(mem_space_id);
+    H5Sclose(file_space_id);
+
+    // Matching the other processes' transfers, also after a failure
+    for (; done < total; done++)
+        _transfer_none(writing, memtype);
+
+    return status >= 0;
+}
+
+// Dataset chunks
+
+bool
+Dataset::get_chunk_dimensions(dimensions& dims) const
+{
+    if (m_metadata.layout != DatasetMetadata::LAYOUT_CHUNKED)
+        return false;
+
+    dims = m_metadata.chunk_dims;
+
+    return true;
+}
+
+template <typename SizeT>
+int
+Dataset::_chunk_iter_callback(const hsize_t *offset, unsigned filter_mask, haddr_t addr, SizeT size, void *data)
+{
+    _ChunkIterData  *iter_data = static_cast<_ChunkIterData*>(data);
+    ChunkInfo       chunk;
+
+    for (int i = 0; i < iter_data->rank; i++)
+        chunk.offset.push_back(offset[i]);
+    chunk.address = addr;
+    chunk.filtered_size = size;
+    chunk.unfiltered_size = 0;
+    chunk.filter_mask = filter_mask;
+
+    iter_data->chunks->push_back(chunk);
+
+    return H5_ITER_CONT;
+}
+
+static bool
+_chunk_address_less(const ChunkInfo& a, const ChunkInfo& b)
+{
+    return a.address < b.address;
+}
+
+bool
+Dataset::get_chunks(std::vector<ChunkInfo>& chunks) const
+{
+    dimensions  chunk_dims;
+
+    if (!get_chunk_dimensions(chunk_dims))
+        return false;
+
+    const int N = m_dimensions.size();
+
+    hsize_t chunk_bytes = m_metadata.element_size;
+
+    for (int i = 0; i < N; i++)
+        chunk_bytes *= chunk_dims[i];
+
+    chunks.clear();
+
+#if H5_VERSION_GE(1,14,1)
+    // Single pass over the chunk index
+    _ChunkIterData  iter_data;
+    iter_data.chunks = &chunks;
+    iter_data.rank = N;
+
+    if (H5Dchunk_iter(m_dataset_id, H5P_DEFAULT, &_chunk_iter_callback, &iter_data) < 0)
+        return false;
+#else
+    // No H5Dchunk_iter(), look up each position in the chunk grid.
+    // Note that H5Dget_chunk_info() would make this quadratic in the
+    // number of chunks
+    hsize_t offset[N];
+    for (int i = 0; i < N; i++)
+    {
+        if (m_dimensions[i] == 0)
+            return true;
+        offset[i] = 0;
+    }
+
+    while (true)
+    {
+        ChunkInfo   chunk;
+
+        if (H5Dget_chunk_info_by_coord(m_dataset_id, offset, &chunk.filter_mask,
+                &chunk.address, &chunk.filtered_size) < 0)
+            return false;
+
+        if (chunk.address != HADDR_UNDEF)
+        {
+            for (int i = 0; i < N; i++)
+                chunk.offset.push_back(offset[i]);
+            chunks.push_back(chunk);
+        }
+
+        // Next grid position, last dimension varying fastest
+        int d = N - 1;
+        for (; d >= 0; d--)
+        {
+            offset[d] += chunk_dims[d];
+            if (offset[d] < (hsize_t)m_dimensions[d])
+                break;
+            offset[d] = 0;
+        }
+
+        if (d < 0)
+            break;
+    }
+#endif
+
+    for (std::vector<ChunkInfo>::iterator it = chunks.begin(), ie = chunks.end(); it != ie; ++it)
+        it->unfiltered_size = chunk_bytes;
+
+    std::sort(chunks.begin(), chunks.end(), _chunk_address_less);
+
+    return true;
+}
+
+template <typename Func>
+bool
+Dataset::for_each_chunk(Func func) const
+{
+    std::vector<ChunkInfo>  chunks;
+
+    if (!get_chunks(chunks))
+        return false;
+
+    for (std::vector<ChunkInfo>::const_iterator it = chunks.begin(), ie = chunks.end(); it != ie; ++it)
+        func(*it);
+
+    return true;
+}
+
+template <typename T, typename Func>
+bool
+Dataset::for_each_chunk(Func func)
+{
+    std::vector<ChunkInfo>  chunks;
+    dimensions              chunk_dims;
+
+    if (!get_chunks(chunks) || !get_chunk_dimensions(chunk_dims))
+    {
+        // Still taking part in the other processes' reads
+        const long long total = _num_transfers(0, true);
+
+        for (long long i = 0; i < total; i++)
+            _transfer_none(false, native_type<T>());
+
+        return false;
+    }
+
+    const int N = m_dimensions.size();
+
+    size_t  chunk_elements = 1;
+    for (int i = 0; i < N; i++)
+        chunk_elements *= chunk_dims[i];
+
+    std::vector<T>  values(chunk_elements);
+    dimensions      count(N);
+    hsize_t         start[N], cnt[N];
+    hid_t           file_space_id, mem_space_id;
+    herr_t          status = 0;
+    long long       done = 0;
+
+    // One read per chunk, each collective with MPI-IO
+    const long long total = _num_transfers(chunks.size(), true);
+
+    file_space_id = H5Dget_space(m_dataset_id);
+
+    for (std::vector<ChunkInfo>::const_iterator it = chunks.begin(), ie = chunks.end(); it != ie; ++it)
+    {
+        // Clip edge chunks to the dataset extent
+        for (int i = 0; i < N; i++)
+        {
+            start[i] = it->offset[i];
+            cnt[i] = std::min(chunk_dims[i], m_dimensions[i] - it->offset[i]);
+            count[i] = cnt[i];
+        }
+
+        H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, start, NULL, cnt, NULL);
+        mem_space_id = H5Screate_simple(N, cnt, NULL);
+
+        status = H5Dread(m_dataset_id, native_type<T>(), mem_space_id, file_space_id, m_transfer_plist, &values[0]);
+        done++;
+
+        H5Sclose(mem_space_id);
+
+        if (status < 0)
+            break;
+
+        func(*it, count, static_cast<const T*>(&values[0]));
+    }
+
+    H5Sclose(file_space_id);
+
+    for (; done < total; done++)
+        _transfer_none(false, native_type<T>());
+
+    return status >= 0;
+}
+
+// Dataset comparison
+
+bool
+Dataset::diff(Dataset& other, std::vector<DatasetDifference>& differences, DiffStatistics *statistics)
+{
+    differences.clear();
+
+    if (!_check_numeric() || !other._check_numeric())
+        return false;
+
+    if (other.m_dimensions != m_dimensions)
+    {
+        fprintf(stderr, "Datasets to compare have different dimensions!\n");
+        return false;
+    }
+
+    Type    type, other_type;
+
+    if (!get_type(type) || !other.get_type(other_type))
+        return false;
+
+    if (H5Tequal(type.get_id(), other_type.get_id()) <= 0)
+    {
+        fprintf(stderr, "Datasets to compare have different types!\n");
+        return false;
+    }
+
+    const int   N = m_dimensions.size();
+    const bool  raw = is_chunked() && other.is_chunked() &&
+        m_metadata.chunk_dims == other.m_metadata.chunk_dims && m_metadata.filters == other.m_metadata.filters;
+
+    DiffStatistics  stats = DiffStatistics();
+
+    // Blocks: chunks, or slabs of whole rows of about 1 MiB
+    dimensions  block(m_dimensions);
+
+    if (is_chunked())
+        block = m_metadata.chunk_dims;
+    else if (other.is_chunked())
+        block = other.m_metadata.chunk_dims;
+    else if (N > 0)
+    {
+        hsize_t row_bytes = m_metadata.native_element_size;
+        for (int i = 1; i < N; i++)
+            row_bytes *= m_dimensions[i];
+        block[0] = std::max<hsize_t>(1024*1024 / std::max<hsize_t>(row_bytes, 1), 1);
+    }
+
+    hsize_t block_elements = 1;
+    for (int i = 0; i < N; i++)
+    {
+        if (m_dimensions[i] == 0)
+            return true;
+        block_elements *= block[i];
+    }
+
+    const size_t    element_size = m_metadata.native_element_size;
+    hid_t           memtype = H5Tget_native_type(type.get_id(), H5T_DIR_ASCEND);
+    std::vector<char>   a(block_elements * element_size), b(block_elements * element_size);
+    std::vector<char>   raw_a, raw_b;
+    dimensions          offset(N, 0), count(N);
+    hsize_t             coord[N];
+    bool                ok = true;
+
+    while (ok)
+    {
+        stats.blocks++;
+
+        for (int i = 0; i < N; i++)
+        {
+            count[i] = std::min(block[i], m_dimensions[i] - offset[i]);
+            coord[i] = offset[i];
+        }
+
+        // Identical stored chunks are equal
+        bool equal = false;
+
+        if (raw)
+        {
+            hsize_t     size_a, size_b;
+            unsigned    mask_a, mask_b;
+            haddr_t     address_a, address_b;
+
+            if (H5Dget_chunk_info_by_coord(m_dataset_id, coord, &mask_a, &address_a, &size_a) >= 0 &&
+                H5Dget_chunk_info_by_coord(other.m_dataset_id, coord, &mask_b, &address_b, &size_b) >= 0 &&
+                address_a != HADDR_UNDEF && address_b != HADDR_UNDEF && size_a == size_b && mask_a == mask_b)
+            {
+                raw_a.resize(size_a);
+                raw_b.resize(size_b);
+
+                uint32_t filter_mask;
+
+                if (H5Dread_chunk(m_dataset_id, H5P_DEFAULT, coord, &filter_mask, &raw_a[0]) < 0 ||
+                    H5Dread_chunk(other.m_dataset_id, H5P_DEFAULT, coord, &filter_mask, &raw_b[0]) < 0)
+                {
+                    ok = false;
+                    break;
+                }
+
+                stats.bytes_read += size_a + size_b;
+                equal = memcmp(&raw_a[0], &raw_b[0], size_a) == 0;
+            }
+        }
+
+        if (equal)
+            stats.raw_equal++;
+        else
+        {
+            hsize_t n = 1;
+            for (int i = 0; i < N; i++)
+                n *= count[i];
+
+            if (!_transfer(false, &a[0], memtype, offset, count, NULL) ||
+                !other._transfer(false, &b[0], memtype, offset, count, NULL))
+            {
+                ok = false;
+                break;
+            }
+
+            stats.decoded++;
+
+            DatasetDifference   difference;
+            difference.num_elements = 0;
+
+            if (memcmp(&a[0], &b[0], n * element_size) != 0)
+            {
+                for (hsize_t i = 0; i < n; i++)
+                    if (memcmp(&a[i * element_size], &b[i * element_size], element_size) != 0)
+                        difference.num_elements++;
+            }
+
+            if (difference.num_elements > 0)
+            {
+                difference.offset = offset;
+                difference.count = count;
+                differences.push_back(difference);
+            }
+        }
+
+        // Next block, last dimension varying fastest
+        int d = N - 1;
+        for (; d >= 0; d--)
+        {
+            offset[d] += block[d];
+            if (offset[d] < m_dimensions[d])
+                break;
+            offset[d] = 0;
+        }
+
+        if (d < 0)
+            break;
+    }
+
+    H5Tclose(memtype);
+
+    if (statistics)
+        *statistics = stats;
+
+    return ok;
+}
+
+// Dataset binary search
+
+template <typename T>
+bool
+Dataset::_probe(hsize_t index, T& value)
+{
+    const hid_t     memtype = native_type<T>();
+    const hsize_t   max_block_size = std::max<hsize_t>(PROBE_BLOCK_BYTES / sizeof(T), 1);
+    const hsize_t   block_size = is_chunked() ? m_metadata.chunk_dims[0] : std::max<hsize_t>(65536 / sizeof(T), 1);
+    hsize_t         first = index / block_size * block_size;
+
+    // Windows within a large chunk, so the cache stays bounded
+    first += (index - first) / max_block_size * max_block_size;
+
+    const hsize_t   count = std::min<hsize_t>(std::min(block_size - first % block_size, max_block_size),
+        m_dimensions[0] - first);
+
+    for (std::list<_ProbeBlock>::iterator it = m_probe_blocks.begin(); it != m_probe_blocks.end(); ++it)
+        if (it->first == first && it->memtype == memtype)
+        {
+            m_probe_blocks.splice(m_probe_blocks.begin(), m_probe_blocks, it);
+            value = reinterpret_cast<const T*>(&it->values[0])[index - first];
+            return true;
+        }
+
+    _ProbeBlock     probe;
+
+    probe.first = first;
+    probe.memtype = memtype;
+    probe.values.resize(count * sizeof(T));
+
+    if (!_transfer(false, &probe.values[0], memtype, dimensions(1, first), dimensions(1, count), NULL))
+        return false;
+
+    value = reinterpret_cast<const T*>(&probe.values[0])[index - first];
+
+    m_probe_blocks.push_front(std::move(probe));
+    if (m_probe_blocks.size() > PROBE_CACHE_SIZE)
+        m_probe_blocks.pop_back();
+
+    return true;
+}
+
+template <typename T>
+bool
+Dataset::_bisect(const T& value, bool upper, hsize_t first, hsize_t& index)
+{
+    if (m_dimensions.size() != 1)
+    {
+        fprintf(stderr, "Binary search needs a 1-D dataset!\n");
+        return false;
+    }
+
+    if (!_check_numeric<T>())
+        return false;
+
+    const hsize_t   size = m_dimensions[0];
+    hsize_t         n = size - std::min(first, size);
+
+    // As std::lower_bound() and std::upper_bound()
+    while (n > 0)
+    {
+        const hsize_t   half = n / 2;
+        const hsize_t   middle = first + half;
+        T               probe;
+
+        if (!_probe(middle, probe))
+            return false;
+
+        if (upper ? !(value < probe) : probe < value)
+        {
+            first = middle + 1;
+            n -= half + 1;
+        }
+        else
+            n = half;
+    }
+
+    index = first;
+
+    return true;
+}
+
+template <typename T>
+bool
+Dataset::lower_bound(const T& value, hsize_t& index)
+{
+    return _bisect(value, false, 0, index);
+}
+
+template <typename T>
+bool
+Dataset::upper_bound(const T& value, hsize_t& index)
+{
+    return _bisect(value, true, 0, index);
+}
+
+template <typename T>
+bool
+Dataset::equal_range(const T& value, hsize_t& first, hsize_t& last)
+{
+    return _bisect(value, false, 0, first) && _bisect(value, true, first, last);
+}
+
+// Dataset attributes
+
+Attribute*
+Dataset::get_attribute(const char *name)
+{
+    hid_t   attribute_id;
+
+    attribute_id = H5Aopen(m_dataset_id, name, H5P_DEFAULT);
+
+    if (attribute_id < 0)
+        return NULL;
+
+    return new Attribute(this, attribute_id);
+}
+
+bool
+Dataset::has_attribute(const char *name)
+{
+    _ErrorSilencer  silencer;
+
+    return H5Aexists(m_dataset_id, name) > 0;
+}
+
+bool
+Dataset::get_attribute(const char *name, Attribute& attribute)
+{
+    hid_t   attribute_id;
+
+    attribute_id = H5Aopen(m_dataset_id, name, H5P_DEFAULT);
+
+    if (attribute_id < 0)
+        return false;
+
+    attribute = Attribute(this, attribute_id);
+
+    return true;
+}
+
+template <typename T>
+bool
+Dataset::create_attribute(const char *name, const dimensions& dims, Attribute& attribute)
+{
+    return _create_attribute(name, dims, native_type<T>(), attribute);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<float>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_FLOAT);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<double>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_DOUBLE);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<int8_t>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_INT8);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<int16_t>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_INT16);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<int32_t>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_INT32);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<int64_t>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_INT64);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<uint8_t>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_UINT8);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<uint16_t>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_UINT16);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<uint32_t>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_UINT32);
+}
+
+template<>
+Attribute*
+Dataset::create_attribute<uint64_t>(const char *name, const dimensions& dims)
+{
+    return _create_attribute(name, dims, H5T_NATIVE_UINT64);
+}
+
+Attribute*
+Dataset::_create_attribute(const char *name, const dimensions& dims, hid_t dtype)
+{
+    Attribute   attribute;
+
+    if (!_create_attribute(name, dims, dtype, attribute))
+        return NULL;
+
+    return new Attribute(std::move(attribute));
+}
+
+bool
+Dataset::_create_attribute(const char *name, const dimensions& dims, hid_t dtype, Attribute& attribute)
+{
+    hid_t   attr_id, dataspace_id;
+
+    const int N = dims.size();
+    hsize_t d[N];
+    for (int i = 0; i < N; i++)
+        d[i] = dims[i];
+    dataspace_id = H5Screate_simple(N, d, NULL);
+
+    attr_id = H5Acreate(m_dataset_id, name, dtype, dataspace_id, H5P_DEFAULT, H5P_DEFAULT);
+
+    H5Sclose(dataspace_id);
+
+    if (attr_id < 0)
+        return false;
+
+    attribute = Attribute(this, attr_id);
+
+    return true;
+}
+
+bool
+Dataset::create_string_attribute(const char *name, const dimensions& dims, size_t length, Attribute& attribute)
+{
+    hid_t   dtype = _string_type(length);
+    bool    ok = _create_attribute(name, dims, dtype, attribute);
+
+    H5Tclose(dtype);
+
+    return ok;
+}
+
+// Dataset strings
+
+bool
+Dataset::read_strings(StringTable& strings)
+{
+    return strings._read(m_dataset_id, true, m_transfer_plist);
+}
+
+bool
+Dataset::write_strings(const std::vector<std::string>& strings)
+{
+    return _write_strings(m_dataset_id, true, strings, m_transfer_plist);
+}
+
+//
+// BufferedWriter
+//
+
+BufferedWriter::BufferedWriter(Dataset *dataset, long long start_row)
+{
+    dimensions  maxdims, chunk_dims;
+
+    m_dataset = dataset;
+    m_appendable = dataset->get_max_dimensions(maxdims) && maxdims[0] == UNLIMITED;
+    m_memtype = -1;
+    m_row_size = 0;
+    m_buffered_rows = 0;
+
+    if (start_row >= 0)
+        m_start_row = start_row;
+    else if (m_appendable)
+    {
+        dimensions dims;
+        dataset->get_dimensions(dims);
+        m_start_row = dims[0];
+    }
+    else
+        m_start_row = 0;
+
+    // Unchunked datasets have no read-modify-write issue, but still
+    // benefit from fewer, larger writes
+    if (dataset->get_chunk_dimensions(chunk_dims))
+        m_chunk_rows = chunk_dims[0];
+    else
+        m_chunk_rows = 0;
+}
+
+BufferedWriter::~BufferedWriter()
+{
+    close();
+}
+
+template <typename T>
+bool
+BufferedWriter::write(const T *values, hsize_t rows)
+{
+    return m_dataset->_check_numeric<T>() && _write(values, rows, native_type<T>());
+}
+
+bool
+BufferedWriter::_write(const void *values, hsize_t rows, hid_t memtype)
+{
+    if (m_row_size == 0)
+    {
+        dimensions  dims;
+        m_dataset->get_dimensions(dims);
+
+        m_row_size = H5Tget_size(memtype);
+        for (size_t i = 1; i < dims.size(); i++)
+            m_row_size *= dims[i];
+
+        if (m_chunk_rows == 0)
+            m_chunk_rows = std::max((hsize_t)(1024*1024 / std::max(m_row_size, (size_t)1)), (hsize_t)1);
+
+        m_memtype = memtype;
+        m_buffer.resize(m_chunk_rows * m_row_size);
+    }
+    else if (H5Tequal(memtype, m_memtype) <= 0)
+    {
+        fprintf(stderr, "BufferedWriter: type differs from previous writes!\n");
+        return false;
+    }
+
+    const char  *p = static_cast<const char*>(values);
+
+    while (rows > 0)
+    {
+        hsize_t row = get_row();
+        hsize_t space = m_chunk_rows - row % m_chunk_rows;
+
+        if (m_buffered_rows == 0 && rows >= space)
+        {
+            // Complete chunks can be written straight from the caller's values
+            hsize_t n = space + (rows - space) / m_chunk_rows * m_chunk_rows;
+
+            if (!_write_rows(p, row, n))
+                return false;
+
+            m_start_row += n;
+            p += n * m_row_size;
+            rows -= n;
+            continue;
+        }
+
+        hsize_t n = std::min(rows, space);
+
+        memcpy(&m_buffer[m_buffered_rows * m_row_size], p, n * m_row_size);
+        m_buffered_rows += n;
+        p += n * m_row_size;
+        rows -= n;
+
+        if (get_row() % m_chunk_rows == 0 && !flush())
+            return false;
+    }
+
+    return true;
+}
+
+bool
+BufferedWriter::_write_rows(const void *values, hsize_t start_row, hsize_t rows)
+{
+    dimensions  dims, offset, count;
+
+    m_dataset->get_dimensions(dims);
+
+    if (start_row + rows > (hsize_t)dims[0])
+    {
+        if (!m_appendable)
+        {
+            fprintf(stderr, "BufferedWriter: write beyond end of dataset!\n");
+            return false;
+        }
+
+        dims[0] = start_row + rows;
+        if (!m_dataset->set_extent(dims))
+            return false;
+    }
+
+    offset.resize(dims.size(), 0);
+    count = dims;
+    offset[0] = start_row;
+    count[0] = rows;
+
+    return m_dataset->_transfer(true, const_cast<void*>(values), m_memtype, offset, count, NULL);
+}
+
+bool
+BufferedWriter::flush()
+{
+    if (m_buffered_rows == 0)
+        return true;
+
+    if (!_write_rows(&m_buffer[0], m_start_row, m_buffered_rows))
+        return false;
+
+    m_start_row += m_buffered_rows;
+    m_buffered_rows = 0;
+
+    return true;
+}
+
+bool
+BufferedWriter::close()
+{
+    if (m_dataset == NULL)
+        return true;
+
+    // Also reported here, as the destructor can't return it
+    const hsize_t   rows = m_buffered_rows;
+    const bool      ok = flush();
+    if (!ok)
+        fprintf(stderr, "BufferedWriter: %llu rows lost on close!\n", (unsigned long long)rows);
+
+    m_buffered_rows = 0;
+    m_dataset = NULL;
+
+    return ok;
+}
+
+//
+// ShardedWriter
+//
+
+ShardedWriter::ShardedWriter(const char *master_fname, const char *path, const dimensions& dims, int num_shards,
+    const DatasetCreationOptions& shard_options):
+    m_master_fname(master_fname), m_path(path), m_dims(dims), m_shard_options(shard_options)
+{
+    // Without shards everything else fails
+    if (dims.empty())
+    {
+        fprintf(stderr, "Sharded dataset needs at least one dimension!\n");
+        m_num_shards = 0;
+        m_rows_per_shard = 0;
+        return;
+    }
+
+    m_num_shards = std::max(num_shards, 1);
+    m_rows_per_shard = (dims[0] + m_num_shards - 1) / m_num_shards;
+}
+
+std::string
+ShardedWriter::_shard_filename(int index, bool with_directory) const
+{
+    std::string             base(m_master_fname);
+    std::string::size_type  slash = base.rfind('/');
+    std::string::size_type  dot = base.rfind('.');
+
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = base.size();
+
+    std::string fname = base.substr(0, dot) + ".shard" + std::to_string(index) + base.substr(dot);
+
+    if (!with_directory && slash != std::string::npos)
+        fname = fname.substr(slash + 1);
+
+    return fname;
+}
+
+bool
+ShardedWriter::get_shard(int index, std::string& fname, dimensions& offset, dimensions& count) const
+{
+    if (index < 0 || index >= m_num_shards)
+        return false;
+
+    fname = _shard_filename(index, true);
+
+    offset.assign(m_dims.size(), 0);
+    count = m_dims;
+
+    offset[0] = std::min(index * m_rows_per_shard, m_dims[0]);
+    count[0] = std::min(m_rows_per_shard, m_dims[0] - offset[0]);
+
+    return true;
+}
+
+template <typename T>
+bool
+ShardedWriter::create_master(bool overwrite)
+{
+    File                        file;
+    Dataset                     dataset;
+    std::vector<VirtualSource>  sources;
+    std::string                 fname;
+
+    if (m_num_shards == 0)
+        return false;
+
+    for (int i = 0; i < m_num_shards; i++)
+    {
+        VirtualSource   source;
+
+        get_shard(i, fname, source.offset, source.count);
+        if (source.count[0] == 0)
+            continue;
+
+        // Relative, so the files can be moved together
+        source.filename = _shard_filename(i, false);
+        source.path = m_path;
+
+        sources.push_back(source);
+    }
+
+    if (!file.create(m_master_fname.c_str(), overwrite))
+        return false;
+
+    return file.create_virtual_dataset<T>(m_path.c_str(), m_dims, sources, dataset);
+}
+
+template <typename T>
+bool
+ShardedWriter::create_shard(int index, File& file, Dataset& dataset)
+{
+    std::string fname;
+    dimensions  offset, count;
+
+    if (!get_shard(index, fname, offset, count))
+        return false;
+
+    if (!file.create(fname.c_str()))
+        return false;
+
+    return file.create_dataset<T>(m_path.c_str(), count, m_shard_options, dataset);
+}
+
+//
+// RaggedArray
+//
+
+template <typename T>
+RaggedArray<T>::RaggedArray()
+{
+    m_values_writer = NULL;
+    m_offsets_writer = NULL;
+}
+
+template <typename T>
+RaggedArray<T>::~RaggedArray()
+{
+    close();
+}
+
+template <typename T>
+bool
+RaggedArray<T>::create(FileAndGroupParent& parent, const char *path, hsize_t chunk_size,
+    bool shuffle, bool enable_deflate_compression, int deflate_level)
+{
+    close();
+
+    if (!parent.create_group(path, m_group))
+        return false;
+
+    DatasetCreationOptions  options;
+    dimensions              dims;
+
+    dims.push_back(0);
+
+    options.layout = DatasetCreationOptions::LAYOUT_CHUNKED;
+    options.chunk_dims.push_back(chunk_size);
+    options.max_dims.push_back(UNLIMITED);
+    options.shuffle = shuffle;
+    if (enable_deflate_compression)
+    {
+        options.compression = DatasetCreationOptions::COMPRESSION_DEFLATE;
+        options.compression_level = deflate_level;
+    }
+
+    if (!m_group.create_dataset<T>("values", dims, options, m_values))
+        return false;
+
+    // Offsets only grow, so shuffled deltas compress well
+    options.shuffle = true;
+    options.compression = DatasetCreationOptions::COMPRESSION_DEFLATE;
+    options.compression_level = deflate_level;
+    options.chunk_dims[0] = 16*1024;
+
+    if (!m_group.create_dataset<uint64_t>("offsets", dims, options, m_offsets_dataset))
+        return false;
+
+    m_offsets_writer = new BufferedWriter(&m_offsets_dataset);
+    m_offsets.push_back(0);
+
+    return m_offsets_writer->write<uint64_t>(&m_offsets[0], 1);
+}
+
+template <typename T>
+bool
+RaggedArray<T>::open(FileAndGroupParent& parent, const char *path)
+{
+    close();
+
+    if (!parent.open_group(path, m_group))
+        return false;
+
+    if (!m_group.open_dataset("values", m_values) || !m_group.open_dataset("offsets", m_offsets_dataset))
+        return false;
+
+    m_offsets.resize(m_offsets_dataset.get_size_in_elements());
+    if (m_offsets.empty() || !m_offsets_dataset.read<uint64_t>(&m_offsets[0]))
+    {
+        fprintf(stderr, "Invalid offsets for ragged array %s!\n", path);
+        m_offsets.clear();
+        return false;
+    }
+
+    return true;
+}
+
+template <typename T>
+bool
+RaggedArray<T>::close()
+{
+    bool ok = flush();
+
+    delete m_values_writer;
+    delete m_offsets_writer;
+    m_values_writer = NULL;
+    m_offsets_writer = NULL;
+
+    m_values.close();
+    m_offsets_dataset.close();
+    m_group.close();
+    m_offsets.clear();
+
+    return ok;
+}
+
+template <typename T>
+bool
+RaggedArray<T>::append(const T *values, hsize_t size)
+{
+    if (m_offsets.empty())
+    {
+        fprintf(stderr, "Ragged array not open!\n");
+        return false;
+    }
+
+    if (m_values_writer == NULL)
+        m_values_writer = new BufferedWriter(&m_values, m_offsets.back());
+    if (m_offsets_writer == NULL)
+        m_offsets_writer = new BufferedWriter(&m_offsets_dataset, m_offsets.size());
+
+    if (size > 0 && !m_values_writer->write<T>(values, size))
+        return false;
+
+    m_offsets.push_back(m_offsets.back() + size);
+
+    return m_offsets_writer->write<uint64_t>(&m_offsets.back(), 1);
+}
+
+template <typename T>
+bool
+RaggedArray<T>::flush()
+{
+    bool ok = true;
+
+    if (m_values_writer != NULL)
+        ok = m_values_writer->flush() && ok;
+    if (m_offsets_writer != NULL)
+        ok = m_offsets_writer->flush() && ok;
+
+    return ok;
+}
+
+template <typename T>
+bool
+RaggedArray<T>::read(hsize_t item, std::vector<T>& values)
+{
+    std::vector<hsize_t> offsets;
+
+    return read_range(item, 1, values, offsets);
+}
+
+template <typename T>
 bool
-Dataset::write<uint8_t>(uint8_t *values)
+RaggedArray<T>::read_range(hsize_t first, hsize_t count, std::vector<T>& values,
+    std::vector<hsize_t>& offsets)
 {
-    return _write<uint8_t>(values, H5T_NATIVE_UINT8);
+    if (first + count > get_num_items())
+    {
+        fprintf(stderr, "Items %llu-%llu out of range (%llu items)!\n",
+            (unsigned long long)first, (unsigned long long)(first + count),
+            (unsigned long long)get_num_items());
+        return false;
+    }
+
+    if (!flush())
+        return false;
+
+    const uint64_t  start = m_offsets[first];
+
+    // Hyperslabs take int offsets and counts
+    if (m_offsets[first + count] > (uint64_t)INT_MAX)
+    {
+        fprintf(stderr, "Values %llu-%llu beyond the %d values a ragged array can read!\n",
+            (unsigned long long)start, (unsigned long long)m_offsets[first + count], INT_MAX);
+        return false;
+    }
+
+    offsets.resize(count + 1);
+    for (hsize_t i = 0; i <= count; i++)
+        offsets[i] = m_offsets[first + i] - start;
+
+    values.resize(offsets[count]);
+    if (values.empty())
+        return true;
+
+    dimensions  offset, cnt;
+
+    offset.push_back(start);
+    cnt.push_back(values.size());
+
+    return m_values.read_hyperslab<T>(&values[0], offset, cnt);
 }
 
-template<>
+//
+// DedupWriter
+//
+
+static inline uint64_t
+_mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Two 64-bit lanes, for content addressing (not for security)
+static inline std::pair<uint64_t, uint64_t>
+_hash_bytes(const void *data, size_t size)
+{
+    const char  *p = static_cast<const char*>(data);
+    uint64_t    h1 = 0x9e3779b97f4a7c15ULL ^ size;
+    uint64_t    h2 = 0xc2b2ae3d27d4eb4fULL + size;
+    uint64_t    w;
+
+    for (size_t i = 0; i < size; i += 8)
+    {
+        w = 0;
+        memcpy(&w, p + i, std::min<size_t>(8, size - i));
+
+        h1 = (h1 ^ _mix64(w)) * 0x9fb21c651e98df25ULL;
+        h1 = (h1 << 29) | (h1 >> 35);
+        h2 = (h2 + (w ^ 0xd6e8feb86659fd93ULL)) * 0xff51afd7ed558ccdULL;
+        h2 ^= h2 >> 32;
+    }
+
+    return std::make_pair(_mix64(h1 ^ (h2 >> 1)), _mix64(h2 + h1));
+}
+
+template <typename T>
+DedupWriter<T>::DedupWriter()
+{
+    m_parent = NULL;
+    m_num_chunks = 0;
+    m_num_unique_chunks = 0;
+}
+
+template <typename T>
 bool
-Dataset::write<uint16_t>(uint16_t *values)
+DedupWriter<T>::create(FileAndGroupParent& parent, const char *pool_path, const dimensions& chunk_dims,
+    const DatasetCreationOptions& options)
 {
-    return _write<uint16_t>(values, H5T_NATIVE_UINT16);
+    close();
+
+    // Unique chunks are stacked along the first axis
+    DatasetCreationOptions  pool_options(options);
+    dimensions              dims(chunk_dims);
+
+    dims[0] = 0;
+    pool_options.layout = DatasetCreationOptions::LAYOUT_CHUNKED;
+    pool_options.chunk_dims = chunk_dims;
+    pool_options.max_dims = chunk_dims;
+    pool_options.max_dims[0] = UNLIMITED;
+
+    if (!parent.create_dataset<T>(pool_path, dims, pool_options, m_pool))
+        return false;
+
+    // Virtual dataset sources are found from the root group
+    ssize_t         length = H5Iget_name(m_pool.get_id(), NULL, 0);
+    std::vector<char> name(std::max<ssize_t>(length, 0) + 1);
+
+    if (length <= 0 || H5Iget_name(m_pool.get_id(), &name[0], name.size()) < 0)
+    {
+        fprintf(stderr, "Could not get the name of the chunk pool!\n");
+        m_pool.close();
+        return false;
+    }
+
+    m_parent = &parent;
+    m_pool_path = &name[0];
+    m_chunk_dims = chunk_dims;
+
+    return true;
 }
 
-template<>
+template <typename T>
+void
+DedupWriter<T>::close()
+{
+    m_pool.close();
+    m_parent = NULL;
+    m_index.clear();
+    m_num_chunks = 0;
+    m_num_unique_chunks = 0;
+}
+
+template <typename T>
 bool
-Dataset::write<uint32_t>(uint32_t *values)
+DedupWriter<T>::write(const char *path, const T *values, const dimensions& dims, Dataset& dataset)
 {
-    return _write<uint32_t>(values, H5T_NATIVE_UINT32);
+    if (m_parent == NULL)
+    {
+        fprintf(stderr, "Dedup writer not created!\n");
+        return false;
+    }
+
+    const int N = m_chunk_dims.size();
+
+    if ((int)dims.size() != N)
+    {
+        fprintf(stderr, "Dataset doesn't match the chunk rank!\n");
+        return false;
+    }
+
+    size_t chunk_elements = 1;
+    for (int i = 0; i < N; i++)
+    {
+        if (dims[i] == 0)
+            return m_parent->create_virtual_dataset<T>(path, dims, std::vector<VirtualSource>(), dataset);
+        chunk_elements *= m_chunk_dims[i];
+    }
+
+    std::vector<T>              chunk(chunk_elements), stored(chunk_elements);
+    std::vector<VirtualSource>  sources;
+    dimensions                  offset(N, 0), count(N), pool_dims, slot_count(m_chunk_dims);
+    hsize_t                     index[N];
+
+    m_pool.get_dimensions(pool_dims);
+
+    while (true)
+    {
+        // Gather the chunk, zero-padded at the edges
+        size_t rows = 1;
+        for (int i = 0; i < N; i++)
+        {
+            count[i] = std::min(m_chunk_dims[i], dims[i] - offset[i]);
+            index[i] = 0;
+            if (i < N - 1)
+                rows *= count[i];
+        }
+
+        if (rows * count[N-1] < chunk_elements)
+            std::fill(chunk.begin(), chunk.end(), T());
+
+        for (size_t r = 0; r < rows; r++)
+        {
+            size_t src = 0, dst = 0;
+            for (int i = 0; i < N - 1; i++)
+            {
+                src = src * dims[i] + offset[i] + index[i];
+                dst = dst * m_chunk_dims[i] + index[i];
+            }
+            src = src * dims[N-1] + offset[N-1];
+            dst = dst * m_chunk_dims[N-1];
+
+            memcpy(&chunk[dst], values + src, count[N-1] * sizeof(T));
+
+            for (int i = N - 2; i >= 0; i--)
+            {
+                if (++index[i] < (hsize_t)count[i])
+                    break;
+                index[i] = 0;
+            }
+        }
+
+        // Look up, comparing the stored bytes, or append to the pool
+        typedef typename std::multimap<std::pair<uint64_t, uint64_t>, hsize_t>::iterator Iterator;
+
+        const std::pair<uint64_t, uint64_t> hash = _hash_bytes(&chunk[0], chunk_elements * sizeof(T));
+        std::pair<Iterator, Iterator>       range = m_index.equal_range(hash);
+        dimensions                          slot_offset(N, 0);
+        hsize_t                             slot = m_num_unique_chunks;
+
+        for (Iterator it = range.first; it != range.second; ++it)
+        {
+            slot_offset[0] = it->second * m_chunk_dims[0];
+
+            if (!m_pool.read_hyperslab<T>(&stored[0], slot_offset, slot_count))
+                return false;
+
+            if (memcmp(&stored[0], &chunk[0], chunk_elements * sizeof(T)) == 0)
+            {
+                slot = it->second;
+                break;
+            }
+        }
+
+        if (slot == m_num_unique_chunks)
+        {
+            slot_offset[0] = slot * m_chunk_dims[0];
+            pool_dims[0] = (slot + 1) * m_chunk_dims[0];
+
+            if (!m_pool.set_extent(pool_dims) || !m_pool.write_hyperslab<T>(&chunk[0], slot_offset, slot_count))
+                return false;
+
+            m_index.insert(std::make_pair(hash, slot));
+            m_num_unique_chunks++;
+        }
+
+        VirtualSource source;
+        source.filename = ".";
+        source.path = m_pool_path;
+        source.source_offset.assign(N, 0);
+        source.source_offset[0] = slot * m_chunk_dims[0];
+        source.offset = offset;
+        source.count = count;
+        sources.push_back(source);
+
+        m_num_chunks++;
+
+        // Next chunk, last dimension varying fastest
+        int d = N - 1;
+        for (; d >= 0; d--)
+        {
+            offset[d] += m_chunk_dims[d];
+            if (offset[d] < dims[d])
+                break;
+            offset[d] = 0;
+        }
+
+        if (d < 0)
+            break;
+    }
+
+    // Written chunks must be in the file before mapping them
+    if (!m_pool.flush())
+        return false;
+
+    return m_parent->create_virtual_dataset<T>(path, dims, sources, dataset);
+}
+
+//
+// FilePool
+//
+
+FilePool::FilePool(size_t max_open, const FileOptions& options):
+    m_options(options)
+{
+    m_max_open = std::max(max_open, (size_t)1);
+}
+
+FilePool::~FilePool()
+{
+    // Handles still held outside the pool keep their files open
+    m_index.clear();
+    m_entries.clear();
 }
 
-template<>
 bool
-Dataset::write<uint64_t>(uint64_t *values)
+FilePool::Entry::in_use() const
 {
-    return _write<uint64_t>(values, H5T_NATIVE_UINT64);
+    if (file.use_count() > 1)
+        return true;
+
+    for (std::map<std::string, std::shared_ptr<Dataset> >::const_iterator it = datasets.begin(); it != datasets.end(); ++it)
+        if (it->second.use_count() > 1)
+            return true;
+
+    return false;
 }
 
-// Dataset attributes
+void
+FilePool::_evict(size_t max_open)
+{
+    std::list<Entry>::iterator it = m_entries.end();
 
-Attribute*
-Dataset::get_attribute(const char *name)
+    while (m_entries.size() > max_open && it != m_entries.begin())
+    {
+        --it;
+
+        if (it->in_use())
+            continue;
+
+        m_index.erase(Key(it->fname, it->readonly));
+        it = m_entries.erase(it);
+    }
+}
+
+FilePool::Entry *
+FilePool::_open(const char *fname, bool readonly)
 {
-    hid_t   attribute_id;
+    std::map<Key, std::list<Entry>::iterator>::iterator it = m_index.find(Key(fname, readonly));
 
-    attribute_id = H5Aopen(m_dataset_id, name, H5P_DEFAULT);
+    if (it != m_index.end())
+    {
+        // Move to the front
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return &m_entries.front();
+    }
 
-    if (attribute_id < 0)
+    _evict(m_max_open - 1);
+
+    std::shared_ptr<File>   file(new File);
+
+    if (!file->open(fname, readonly, m_options))
         return NULL;
 
-    return new Attribute(this, attribute_id);
+    m_entries.push_front(Entry());
+
+    Entry& entry = m_entries.front();
+
+    entry.fname = fname;
+    entry.readonly = readonly;
+    entry.file = file;
+
+    m_index[Key(fname, readonly)] = m_entries.begin();
+
+    return &entry;
 }
 
-template<>
-Attribute*
-Dataset::create_attribute<float>(const char *name, const dimensions& dims)
+std::shared_ptr<File>
+FilePool::open(const char *fname, bool readonly)
 {
-    return _create_attribute(name, dims, H5T_NATIVE_FLOAT);
+    Entry *entry = _open(fname, readonly);
+
+    if (entry == NULL)
+        return std::shared_ptr<File>();
+
+    return entry->file;
 }
 
-template<>
-Attribute*
-Dataset::create_attribute<double>(const char *name, const dimensions& dims)
+std::shared_ptr<Dataset>
+FilePool::open_dataset(const char *fname, const char *path, bool readonly)
 {
-    return _create_attribute(name, dims, H5T_NATIVE_DOUBLE);
+    Entry *entry = _open(fname, readonly);
+
+    if (entry == NULL)
+        return std::shared_ptr<Dataset>();
+
+    std::map<std::string, std::shared_ptr<Dataset> >::iterator it = entry->datasets.find(path);
+
+    if (it != entry->datasets.end())
+        return it->second;
+
+    std::shared_ptr<Dataset>    dataset(new Dataset);
+
+    if (!entry->file->open_dataset(path, *dataset))
+        return std::shared_ptr<Dataset>();
+
+    entry->datasets[path] = dataset;
+
+    return dataset;
 }
 
-template<>
-Attribute*
-Dataset::create_attribute<int8_t>(const char *name, const dimensions& dims)
+void
+FilePool::clear()
 {
-    return _create_attribute(name, dims, H5T_NATIVE_INT8);
+    _evict(0);
 }
 
-template<>
-Attribute*
-Dataset::create_attribute<int16_t>(const char *name, const dimensions& dims)
+//
+// DirectReader
+//
+
+DirectReader::DirectReader()
 {
-    return _create_attribute(name, dims, H5T_NATIVE_INT16);
+    m_fd = -1;
 }
 
-template<>
-Attribute*
-Dataset::create_attribute<int32_t>(const char *name, const dimensions& dims)
+DirectReader::~DirectReader()
 {
-    return _create_attribute(name, dims, H5T_NATIVE_INT32);
+    close();
+}
+
+void
+DirectReader::close()
+{
+    if (m_fd < 0)
+        return;
+
+    ::close(m_fd);
+    m_fd = -1;
+    m_chunk_addresses.clear();
+}
+
+bool
+DirectReader::open(Dataset& dataset)
+{
+    close();
+
+    const DatasetMetadata&  metadata = dataset.get_metadata();
+
+    if (metadata.type_class != Type::INTEGER && metadata.type_class != Type::FLOAT)
+    {
+        fprintf(stderr, "Direct reads need a numeric dataset!\n");
+        return false;
+    }
+
+    if (metadata.element_size != metadata.native_element_size || !metadata.filters.empty())
+    {
+        fprintf(stderr, "Direct reads need unfiltered data in the native type!\n");
+        return false;
+    }
+
+    Type    type;
+
+    if (!dataset.get_type(type))
+        return false;
+
+    hid_t   native_type_id = H5Tget_native_type(type.get_id(), H5T_DIR_ASCEND);
+    bool    native = H5Tequal(native_type_id, type.get_id()) > 0;
+
+    H5Tclose(native_type_id);
+
+    if (!native)
+    {
+        fprintf(stderr, "Direct reads need data in the native byte order!\n");
+        return false;
+    }
+
+    // Data addresses are relative to the end of any user block
+
+    hid_t   file_id = H5Iget_file_id(dataset.get_id());
+    hid_t   plist_id = H5Fget_create_plist(file_id);
+    hsize_t userblock_size = 0;
+
+    H5Pget_userblock(plist_id, &userblock_size);
+    H5Pclose(plist_id);
+
+    ssize_t length = H5Fget_name(file_id, NULL, 0);
+    std::vector<char> fname(length + 1);
+    H5Fget_name(file_id, &fname[0], length + 1);
+
+    H5Fclose(file_id);
+
+    if (userblock_size > 0)
+    {
+        fprintf(stderr, "Direct reads don't support files with a user block!\n");
+        return false;
+    }
+
+    dataset.get_dimensions(m_dims);
+    m_type_class = metadata.type_class;
+    m_signed = metadata.is_signed;
+    m_element_size = metadata.element_size;
+    m_address = HADDR_UNDEF;
+    m_chunk_dims.clear();
+    m_chunk_grid.clear();
+
+    const int N = m_dims.size();
+
+    if (metadata.external)
+    {
+        fprintf(stderr, "Direct reads don't support external datasets!\n");
+        return false;
+    }
+
+    if (metadata.layout == DatasetMetadata::LAYOUT_CONTIGUOUS)
+    {
+        m_address = H5Dget_offset(dataset.get_id());
+    }
+    else if (metadata.layout == DatasetMetadata::LAYOUT_CHUNKED)
+    {
+        std::vector<ChunkInfo>  chunks;
+
+        if (!dataset.get_chunks(chunks))
+            return false;
+
+        m_chunk_dims = metadata.chunk_dims;
+
+        size_t num_chunks = 1;
+        for (int i = 0; i < N; i++)
+        {
+            m_chunk_grid.push_back((m_dims[i] + m_chunk_dims[i] - 1) / m_chunk_dims[i]);
+            num_chunks *= m_chunk_grid[i];
+        }
+
+        m_chunk_addresses.assign(num_chunks, HADDR_UNDEF);
+
+        for (size_t c = 0; c < chunks.size(); c++)
+        {
+            size_t index = 0;
+            for (int i = 0; i < N; i++)
+                index = index * m_chunk_grid[i] + chunks[c].offset[i] / m_chunk_dims[i];
+            m_chunk_addresses[index] = chunks[c].address;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Direct reads need a contiguous or chunked dataset!\n");
+        return false;
+    }
+
+    m_fd = ::open(&fname[0], O_RDONLY);
+    if (m_fd < 0)
+    {
+        fprintf(stderr, "Can't open %s: %s\n", &fname[0], strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+template <typename T>
+bool
+DirectReader::read_hyperslab(T *values, const dimensions& offset, const dimensions& count) const
+{
+    const Type::Class type_class = std::is_floating_point<T>::value ? Type::FLOAT : Type::INTEGER;
+
+    if (type_class != m_type_class || sizeof(T) != m_element_size ||
+        (type_class == Type::INTEGER && std::is_signed<T>::value != m_signed))
+    {
+        fprintf(stderr, "Direct reads need the type of the dataset!\n");
+        return false;
+    }
+
+    return _read_hyperslab((char*)values, offset, count);
 }
 
-template<>
-Attribute*
-Dataset::create_attribute<int64_t>(const char *name, const dimensions& dims)
-{
-    return _create_attribute(name, dims, H5T_NATIVE_INT64);
-}
+// Copy the part start..start+count of a row-major block at address in the
+// file into values (with dimensions values_dims) at values_start, with
+// one pread() for the whole range
+bool
+DirectReader::_read_block(char *values, const hsize_t *values_dims, const hsize_t *values_start,
+    haddr_t address, const hsize_t *block_dims, const hsize_t *start, const hsize_t *count) const
+{
+    const int       N = m_dims.size();
+    const size_t    E = m_element_size;
+
+    // Ranges of elements holding the part, in the block and in values
+    hsize_t first = 0, last = 0, dst_first = 0, dst_last = 0, n = 1;
+    for (int i = 0; i < N; i++)
+    {
+        first = first * block_dims[i] + start[i];
+        last = last * block_dims[i] + start[i] + count[i] - 1;
+        dst_first = dst_first * values_dims[i] + values_start[i];
+        dst_last = dst_last * values_dims[i] + values_start[i] + count[i] - 1;
+        n *= count[i];
+    }
+
+    const size_t    bytes = (last - first + 1) * E;
+
+    // Straight into values when the part is contiguous in both
+    const bool      contiguous = last - first + 1 == n && dst_last - dst_first + 1 == n;
+
+    // Mostly gaps (e.g. a few columns of a wide dataset): split along the
+    // first axis with more than one element, instead of reading it all
+    if (!contiguous && last - first + 1 > 2 * n + 64*1024 / E)
+    {
+        int k = 0;
+        while (count[k] == 1)
+            k++;
+
+        hsize_t sub_start[N], sub_count[N], sub_values_start[N];
+
+        for (int i = 0; i < N; i++)
+        {
+            sub_start[i] = start[i];
+            sub_count[i] = count[i];
+            sub_values_start[i] = values_start[i];
+        }
+
+        sub_count[k] = 1;
+
+        for (hsize_t j = 0; j < count[k]; j++)
+        {
+            sub_start[k] = start[k] + j;
+            sub_values_start[k] = values_start[k] + j;
+
+            if (!_read_block(values, values_dims, sub_values_start, address, block_dims, sub_start, sub_count))
+                return false;
+        }
+
+        return true;
+    }
+
+    std::vector<char>   buffer;
+    char                *data;
+
+    if (contiguous)
+        data = values + dst_first * E;
+    else
+    {
+        buffer.resize(bytes);
+        data = &buffer[0];
+    }
+
+    if (address == HADDR_UNDEF)
+        memset(data, 0, bytes);
+    else if (!_pread_all(m_fd, data, bytes, address + first * E))
+        return false;
 
-template<>
-Attribute*
-Dataset::create_attribute<uint8_t>(const char *name, const dimensions& dims)
-{
-    return _create_attribute(name, dims, H5T_NATIVE_UINT8);
-}
+    if (contiguous)
+        return true;
 
-template<>
-Attribute*
-Dataset::create_attribute<uint16_t>(const char *name, const dimensions& dims)
-{
-    return _create_attribute(name, dims, H5T_NATIVE_UINT16);
-}
+    // Scatter the rows (along the last axis)
+    const size_t    row_bytes = count[N-1] * E;
+    hsize_t         index[N];
 
-template<>
-Attribute*
-Dataset::create_attribute<uint32_t>(const char *name, const dimensions& dims)
-{
-    return _create_attribute(name, dims, H5T_NATIVE_UINT32);
-}
+    for (int i = 0; i < N; i++)
+        index[i] = 0;
 
-template<>
-Attribute*
-Dataset::create_attribute<uint64_t>(const char *name, const dimensions& dims)
-{
-    return _create_attribute(name, dims, H5T_NATIVE_UINT64);
+    while (true)
+    {
+        hsize_t src = 0, dst = 0;
+        for (int i = 0; i < N; i++)
+        {
+            src = src * block_dims[i] + start[i] + index[i];
+            dst = dst * values_dims[i] + values_start[i] + index[i];
+        }
+
+        memcpy(values + dst * E, data + (src - first) * E, row_bytes);
+
+        int d = N - 2;
+        for (; d >= 0; d--)
+        {
+            if (++index[d] < count[d])
+                break;
+            index[d] = 0;
+        }
+
+        if (d < 0)
+            break;
+    }
+
+    return true;
 }
 
-Attribute*
-Dataset::_create_attribute(const char *name, const dimensions& dims, hid_t dtype)
+bool
+DirectReader::_read_hyperslab(char *values, const dimensions& offset, const dimensions& count) const
 {
-    hid_t   attr_id, dataspace_id;
+    const int N = m_dims.size();
+
+    if (m_fd < 0)
+    {
+        fprintf(stderr, "Direct reader not open!\n");
+        return false;
+    }
+
+    if ((int)offset.size() != N || (int)count.size() != N)
+    {
+        fprintf(stderr, "Hyperslab doesn't match dataset rank!\n");
+        return false;
+    }
+
+    hsize_t values_dims[N], zero[N], start[N], cnt[N], dims[N];
 
-    const int N = dims.size();
-    hsize_t d[N];
     for (int i = 0; i < N; i++)
-        d[i] = dims[i];
-    dataspace_id = H5Screate_simple(N, d, NULL);
+    {
+        if (offset[i] + count[i] > m_dims[i])
+        {
+            fprintf(stderr, "Hyperslab out of range!\n");
+            return false;
+        }
+
+        if (count[i] == 0)
+            return true;
+
+        values_dims[i] = count[i];
+        zero[i] = 0;
+        start[i] = offset[i];
+        cnt[i] = count[i];
+        dims[i] = m_dims[i];
+    }
 
-    attr_id = H5Acreate(m_dataset_id, name, dtype, dataspace_id, H5P_DEFAULT, H5P_DEFAULT);
+    if (m_chunk_dims.empty())
+        return _read_block(values, values_dims, zero, m_address, dims, start, cnt);
 
-    H5Sclose(dataspace_id);
+    // All chunks overlapping the hyperslab
 
-    if (attr_id < 0)
-        return NULL;
+    hsize_t first[N], last[N], chunk[N];
+
+    for (int i = 0; i < N; i++)
+    {
+        first[i] = offset[i] / m_chunk_dims[i];
+        last[i] = (offset[i] + count[i] - 1) / m_chunk_dims[i];
+        chunk[i] = first[i];
+    }
+
+    while (true)
+    {
+        hsize_t block_dims[N], block_start[N], block_count[N], values_start[N];
+        size_t  index = 0;
+
+        for (int i = 0; i < N; i++)
+        {
+            const hsize_t origin = chunk[i] * m_chunk_dims[i];
+            const hsize_t from = std::max(origin, (hsize_t)offset[i]);
+            const hsize_t to = std::min(origin + m_chunk_dims[i], (hsize_t)(offset[i] + count[i]));
+
+            block_dims[i] = m_chunk_dims[i];
+            block_start[i] = from - origin;
+            block_count[i] = to - from;
+            values_start[i] = from - offset[i];
+
+            index = index * m_chunk_grid[i] + chunk[i];
+        }
+
+        if (!_read_block(values, values_dims, values_start, m_chunk_addresses[index], block_dims, block_start, block_count))
+            return false;
+
+        int d = N - 1;
+        for (; d >= 0; d--)
+        {
+            if (++chunk[d] <= last[d])
+                break;
+            chunk[d] = first[d];
+        }
+
+        if (d < 0)
+            break;
+    }
 
-    return new Attribute(this, attr_id);
+    return true;
 }
 
 //
 // Attribute
 //
 
-Attribute::Attribute(Dataset *dataset, hid_t attr_id)
+Attribute::Attribute()
+{
+    m_attribute_id = -1;
+}
+
+Attribute::Attribute(Dataset *, hid_t attr_id)
 {
-    m_dataset = dataset;
     m_attribute_id = attr_id;
 }
 
+Attribute::Attribute(Attribute&& other)
+{
+    m_attribute_id = other.m_attribute_id;
+    other.m_attribute_id = -1;
+}
+
 Attribute::~Attribute()
 {
+    close();
+}
+
+Attribute&
+Attribute::operator=(Attribute&& other)
+{
+    if (this != &other)
+    {
+        close();
+        m_attribute_id = other.m_attribute_id;
+        other.m_attribute_id = -1;
+    }
+
+    return *this;
+}
+
+void
+Attribute::close()
+{
+    if (m_attribute_id < 0)
+        return;
+
     H5Aclose(m_attribute_id);
+    m_attribute_id = -1;
 }
 
 bool
@@ -980,6 +7181,19 @@ Attribute::get_type()
     return new Type(H5Aget_type(m_attribute_id));
 }
 
+bool
+Attribute::get_type(Type& type)
+{
+    hid_t   type_id = H5Aget_type(m_attribute_id);
+
+    if (type_id < 0)
+        return false;
+
+    type = Type(type_id);
+
+    return true;
+}
+
 
 // Attribute::read
 
@@ -1033,6 +7247,450 @@ template<> bool Attribute::write<uint16_t>(uint16_t *values) { return _write(val
 template<> bool Attribute::write<uint32_t>(uint32_t *values) { return _write(values, H5T_NATIVE_UINT32); }
 template<> bool Attribute::write<uint64_t>(uint64_t *values) { return _write(values, H5T_NATIVE_UINT64); }
 
+// Attribute strings
+
+bool
+Attribute::read_strings(StringTable& strings)
+{
+    return strings._read(m_attribute_id, false, H5P_DEFAULT);
+}
+
+bool
+Attribute::write_strings(const std::vector<std::string>& strings)
+{
+    return _write_strings(m_attribute_id, false, strings, H5P_DEFAULT);
+}
+
+//
+// Pyramid
+//
+
+PyramidOptions::PyramidOptions()
+{
+    method = METHOD_MEAN;
+    factor = 2;
+    min_size = 256;
+    memory_budget = 256*1024*1024;
+}
+
+static std::string
+_pyramid_level_path(const char *path, int level)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_level%d", level);
+
+    return std::string(path) + suffix;
+}
+
+// Block [i*f, (i+1)*f) along each axis (clipped) of a dense 3-D block to
+// one element, the minimum, maximum or first one
+template <typename T>
+static void
+_downsample(const T *src, const hsize_t *src_dims, T *dst, const hsize_t *dst_dims, const hsize_t *factors,
+    PyramidOptions::Method method)
+{
+    T *p = dst;
+
+    for (hsize_t o0 = 0; o0 < dst_dims[0]; o0++)
+    {
+        const hsize_t b0 = o0 * factors[0], e0 = std::min(b0 + factors[0], src_dims[0]);
+
+        for (hsize_t o1 = 0; o1 < dst_dims[1]; o1++)
+        {
+            const hsize_t b1 = o1 * factors[1], e1 = std::min(b1 + factors[1], src_dims[1]);
+
+            for (hsize_t o2 = 0; o2 < dst_dims[2]; o2++)
+            {
+                const hsize_t b2 = o2 * factors[2], e2 = std::min(b2 + factors[2], src_dims[2]);
+
+                T value = src[(b0 * src_dims[1] + b1) * src_dims[2] + b2];
+
+                if (method != PyramidOptions::METHOD_DECIMATE)
+                {
+                    for (hsize_t i0 = b0; i0 < e0; i0++)
+                        for (hsize_t i1 = b1; i1 < e1; i1++)
+                        {
+                            const T *q = src + (i0 * src_dims[1] + i1) * src_dims[2];
+
+                            for (hsize_t i2 = b2; i2 < e2; i2++)
+                                if (method == PyramidOptions::METHOD_MIN ? q[i2] < value : value < q[i2])
+                                    value = q[i2];
+                        }
+                }
+
+                *p++ = value;
+            }
+        }
+    }
+}
+
+// As _downsample(), but summing each block
+static void
+_sum_blocks(const double *src, const hsize_t *src_dims, double *dst, const hsize_t *dst_dims, const hsize_t *factors)
+{
+    double *p = dst;
+
+    for (hsize_t o0 = 0; o0 < dst_dims[0]; o0++)
+    {
+        const hsize_t b0 = o0 * factors[0], e0 = std::min(b0 + factors[0], src_dims[0]);
+
+        for (hsize_t o1 = 0; o1 < dst_dims[1]; o1++)
+        {
+            const hsize_t b1 = o1 * factors[1], e1 = std::min(b1 + factors[1], src_dims[1]);
+
+            for (hsize_t o2 = 0; o2 < dst_dims[2]; o2++)
+            {
+                const hsize_t b2 = o2 * factors[2], e2 = std::min(b2 + factors[2], src_dims[2]);
+                double        sum = 0;
+
+                for (hsize_t i0 = b0; i0 < e0; i0++)
+                    for (hsize_t i1 = b1; i1 < e1; i1++)
+                    {
+                        const double *q = src + (i0 * src_dims[1] + i1) * src_dims[2];
+
+                        for (hsize_t i2 = b2; i2 < e2; i2++)
+                            sum += q[i2];
+                    }
+
+                *p++ = sum;
+            }
+        }
+    }
+}
+
+// Means from the sums of a slab of a level starting at row first_row,
+// each element covering scales[i] elements of level 0 (with dimensions
+// dims0) along axis i, fewer at the far edges
+template <typename T>
+static void
+_block_means(const double *sums, const hsize_t *slab_dims, hsize_t first_row, const hsize_t *dims0,
+    const hsize_t *scales, T *dst)
+{
+    std::vector<hsize_t> counts[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        const hsize_t first = i == 0 ? first_row : 0;
+
+        counts[i].resize(slab_dims[i]);
+        for (hsize_t o = 0; o < slab_dims[i]; o++)
+            counts[i][o] = std::min((first + o + 1) * scales[i], dims0[i]) - (first + o) * scales[i];
+    }
+
+    for (hsize_t o0 = 0; o0 < slab_dims[0]; o0++)
+        for (hsize_t o1 = 0; o1 < slab_dims[1]; o1++)
+            for (hsize_t o2 = 0; o2 < slab_dims[2]; o2++)
+            {
+                const double mean = *sums++ / (counts[0][o0] * counts[1][o1] * counts[2][o2]);
+                *dst++ = std::is_floating_point<T>::value ? (T)mean : (T)std::floor(mean + 0.5);
+            }
+}
+
+static void
+_delete_pyramid_levels(FileAndGroupParent& parent, const char *path, int num_levels)
+{
+    for (int level = 1; level <= num_levels; level++)
+        H5Ldelete(parent.get_id(), _pyramid_level_path(path, level).c_str(), H5P_DEFAULT);
+}
+
+Pyramid::Pyramid()
+{
+    m_factor = 0;
+}
+
+template <typename T>
+bool
+Pyramid::build(FileAndGroupParent& parent, const char *path, const PyramidOptions& options)
+{
+    Dataset     source;
+    dimensions  dims;
+
+    if (!parent.open_dataset(path, source))
+        return false;
+
+    source.get_dimensions(dims);
+
+    const int N = dims.size();
+
+    if (N != 2 && N != 3)
+    {
+        fprintf(stderr, "Pyramids need a 2-D or 3-D dataset!\n");
+        return false;
+    }
+
+    if (options.factor < 2)
+    {
+        fprintf(stderr, "Pyramid factor must be at least 2!\n");
+        return false;
+    }
+
+    // All levels are known up front, so that each slab of the source goes
+    // through every level in memory: no level gets read back, and means
+    // are those of the level 0 elements each element covers
+
+    const hsize_t           factor = options.factor;
+    const hsize_t           factors[3] = { factor, factor, N == 3 ? factor : 1 };
+    std::vector<dimensions> level_dims(1, dims);
+    hsize_t                 scale = 1;
+
+    while (*std::max_element(level_dims.back().begin(), level_dims.back().end()) > options.min_size)
+    {
+        dimensions next(N);
+        for (int i = 0; i < N; i++)
+            next[i] = (level_dims.back()[i] + factor - 1) / factor;
+
+        level_dims.push_back(next);
+        scale *= factor;
+    }
+
+    const int               num_levels = level_dims.size() - 1;
+    std::vector<Dataset>    levels(num_levels + 1);
+
+    for (int level = 1; level <= num_levels; level++)
+    {
+        std::string level_path = _pyramid_level_path(path, level);
+        if (!parent.create_dataset<T>(level_path.c_str(), level_dims[level], options.dataset_options, levels[level]))
+        {
+            _delete_pyramid_levels(parent, path, level - 1);
+            return false;
+        }
+    }
+
+    // Slabs of whole rows, a multiple of factor^num_levels (so that every
+    // level of a slab only depends on that slab) and, if that fits the
+    // budget, of the source chunk rows, so that no chunk gets read twice
+
+    const bool  mean = options.method == PyramidOptions::METHOD_MEAN;
+    hsize_t     row_elements = 1;
+    for (int i = 1; i < N; i++)
+        row_elements *= dims[i];
+
+    // The coarser levels take at most a third of what level 0 does
+    const size_t    element_bytes = (sizeof(T) + (mean ? sizeof(double) : 0)) * 4 / 3 + 1;
+    const size_t    budget = options.memory_budget / element_bytes;
+
+    hsize_t unit = scale;
+    if (source.is_chunked())
+    {
+        const int   chunk_rows = source.get_metadata().chunk_dims[0];
+        hsize_t     aligned = std::min<hsize_t>(chunk_rows / _gcd(chunk_rows, scale % chunk_rows) * scale, dims[0]);
+
+        aligned = (aligned + scale - 1) / scale * scale;
+        if (std::min<hsize_t>(aligned, dims[0]) * row_elements <= budget)
+            unit = aligned;
+    }
+
+    if (std::min<hsize_t>(unit, dims[0]) * row_elements > budget)
+        fprintf(stderr, "Memory budget too small for %llu rows of a %d-level pyramid, using more!\n",
+            (unsigned long long)std::min<hsize_t>(unit, dims[0]), num_levels);
+
+    const hsize_t   slab_rows = std::max<hsize_t>(budget / (unit * row_elements), 1) * unit;
+
+    std::vector<T>      in, out;
+    std::vector<double> sums, next_sums;
+    dimensions          offset(N, 0), count(dims);
+    hsize_t             dims0[3], src_dims[3], dst_dims[3], scales[3];
+    bool                ok = true;
+
+    for (int i = 0; i < 3; i++)
+        dims0[i] = i < N ? dims[i] : 1;
+
+    for (hsize_t row = 0; ok && row < (hsize_t)dims[0]; row += slab_rows)
+    {
+        const hsize_t rows = std::min<hsize_t>(slab_rows, dims[0] - row);
+
+        offset[0] = row;
+        count[0] = rows;
+
+        for (int i = 0; i < 3; i++)
+        {
+            src_dims[i] = i < N ? count[i] : 1;
+            scales[i] = 1;
+        }
+
+        in.resize(rows * row_elements);
+
+        if (!source.read_hyperslab<T>(&in[0], offset, count))
+        {
+            ok = false;
+            break;
+        }
+
+        if (mean)
+            sums.assign(in.begin(), in.end());
+
+        for (int level = 1; ok && level <= num_levels; level++)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                dst_dims[i] = (src_dims[i] + factors[i] - 1) / factors[i];
+                scales[i] *= factors[i];
+            }
+
+            out.resize(dst_dims[0] * dst_dims[1] * dst_dims[2]);
+
+            if (mean)
+            {
+                next_sums.resize(out.size());
+                _sum_blocks(&sums[0], src_dims, &next_sums[0], dst_dims, factors);
+                _block_means<T>(&next_sums[0], dst_dims, row / scales[0], dims0, scales, &out[0]);
+                sums.swap(next_sums);
+            }
+            else
+                _downsample<T>(&in[0], src_dims, &out[0], dst_dims, factors, options.method);
+
+            dimensions  dst_offset(N, 0), dst_count(N);
+            for (int i = 0; i < N; i++)
+                dst_count[i] = dst_dims[i];
+            dst_offset[0] = row / scales[0];
+
+            ok = levels[level].write_hyperslab<T>(&out[0], dst_offset, dst_count);
+
+            in.swap(out);
+            std::copy(dst_dims, dst_dims + 3, src_dims);
+        }
+    }
+
+    // Recorded on the dataset, so that open() needn't look for levels;
+    // "pyramid" goes last, as open() relies on it
+
+    const char *methods[] = { "mean", "min", "max", "decimate" };
+    int32_t     values[2] = { num_levels, options.factor };
+
+    Attribute   attribute;
+    dimensions  attribute_dims(1, 2);
+
+    ok = ok && source.create_string_attribute("pyramid_method", dimensions(1, 1), 0, attribute) &&
+        attribute.write_strings(std::vector<std::string>(1, methods[options.method]));
+
+    ok = ok && source.create_attribute<int32_t>("pyramid", attribute_dims, attribute) &&
+        attribute.write<int32_t>(values);
+
+    if (!ok)
+    {
+        attribute.close();
+        levels.clear();
+
+        if (source.has_attribute("pyramid_method"))
+            H5Adelete(source.get_id(), "pyramid_method");
+        if (source.has_attribute("pyramid"))
+            H5Adelete(source.get_id(), "pyramid");
+
+        _delete_pyramid_levels(parent, path, num_levels);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+Pyramid::open(FileAndGroupParent& parent, const char *path)
+{
+    close();
+
+    Dataset     source;
+    Attribute   attribute;
+    int32_t     values[2];
+
+    if (!parent.open_dataset(path, source))
+        return false;
+
+    if (!source.get_attribute("pyramid", attribute) || !attribute.read<int32_t>(values))
+    {
+        fprintf(stderr, "Dataset %s has no pyramid!\n", path);
+        return false;
+    }
+
+    attribute.close();
+
+    m_levels.resize(values[0] + 1);
+    m_levels[0] = std::move(source);
+    m_factor = values[1];
+
+    for (int level = 1; level <= values[0]; level++)
+    {
+        if (!parent.open_dataset(_pyramid_level_path(path, level).c_str(), m_levels[level]))
+        {
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+Pyramid::close()
+{
+    m_levels.clear();
+    m_factor = 0;
+}
+
+int
+Pyramid::select_level(const dimensions& count, const dimensions& resolution) const
+{
+    int     level = 0;
+    hsize_t scale = m_factor;
+
+    for (int k = 1; k < get_num_levels(); k++, scale *= m_factor)
+    {
+        for (size_t i = 0; i < count.size(); i++)
+            if ((hsize_t)count[i] < resolution[i] * scale)
+                return level;
+
+        level = k;
+    }
+
+    return level;
+}
+
+template <typename T>
+int
+Pyramid::read_region(const dimensions& offset, const dimensions& count, const dimensions& resolution,
+    std::vector<T>& values, dimensions& dims)
+{
+    if (m_levels.empty())
+    {
+        fprintf(stderr, "Pyramid not open!\n");
+        return -1;
+    }
+
+    const int N = m_levels[0].get_rank();
+
+    if ((int)offset.size() != N || (int)count.size() != N || (int)resolution.size() != N)
+    {
+        fprintf(stderr, "Region doesn't match pyramid rank!\n");
+        return -1;
+    }
+
+    const int   level = select_level(count, resolution);
+    hsize_t     scale = 1;
+    dimensions  level_dims, level_offset(N);
+
+    for (int k = 0; k < level; k++)
+        scale *= m_factor;
+
+    m_levels[level].get_dimensions(level_dims);
+    dims.resize(N);
+
+    size_t  size = 1;
+    for (int i = 0; i < N; i++)
+    {
+        const hsize_t end = std::min<hsize_t>((offset[i] + count[i] + scale - 1) / scale, level_dims[i]);
+
+        level_offset[i] = std::min<hsize_t>(offset[i] / scale, end);
+        dims[i] = end - level_offset[i];
+        size *= dims[i];
+    }
+
+    values.resize(size);
+
+    if (size > 0 && !m_levels[level].read_hyperslab<T>(&values[0], level_offset, dims))
+        return -1;
+
+    return level;
+}
+
 } // namespace h5
 
 #endif